@@ -0,0 +1,347 @@
+#pragma once
+#include "../pch.h"
+#include "DataProcessing.h"
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#define LANTERN_AUGMENT_X86 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LANTERN_AUGMENT_NEON 1
+#endif
+
+namespace lantern {
+
+    namespace data {
+
+        /**
+         * @brief Random augmentation applied by the workers to every image before it enter the ring
+         * @ingroup LanternDataProcessing
+         */
+        struct Augmentation {
+            float crop_scale_min = 1.0f;              // smallest crop area relative to the image, 1 disable the random crop
+            float crop_scale_max = 1.0f;              // largest crop area relative to the image
+            float crop_ratio_min = 3.0f / 4.0f;       // smallest aspect ratio (width / height) of the crop
+            float crop_ratio_max = 4.0f / 3.0f;       // largest aspect ratio (width / height) of the crop
+            float flip_probability = 0.0f;            // chance of horizontal flip
+            float brightness = 0.0f;                  // brightness shift drawn in [-brightness, brightness] of full range
+            float contrast = 0.0f;                    // contrast factor drawn in [1 - contrast, 1 + contrast] around mid gray
+
+            bool HasCrop() const {
+                return this->crop_scale_min < 1.0f;
+            }
+
+            bool IsEnabled() const {
+                return this->HasCrop() || this->flip_probability > 0.0f || this->brightness > 0.0f || this->contrast > 0.0f;
+            }
+
+            bool IsValid() const {
+                return this->crop_scale_min > 0.0f && this->crop_scale_min <= this->crop_scale_max && this->crop_scale_max <= 1.0f &&
+                       this->crop_ratio_min > 0.0f && this->crop_ratio_min <= this->crop_ratio_max &&
+                       this->flip_probability >= 0.0f && this->flip_probability <= 1.0f &&
+                       this->brightness >= 0.0f && this->brightness <= 1.0f && this->contrast >= 0.0f && this->contrast <= 1.0f;
+            }
+        };
+
+        /**
+         * @brief Region of the source image kept by the random crop
+         * @ingroup LanternDataProcessing
+         */
+        struct CropRect {
+            uint32_t x = 0, y = 0, width = 0, height = 0;
+        };
+
+        /**
+         * @brief Pixel level augmentation of one sample
+         * @ingroup LanternDataProcessing
+         */
+        struct PixelJitter {
+            bool flip = false;
+            float gain = 1.0f, bias = 0.0f; // pixel * gain + bias
+        };
+
+        /**
+         * @brief Get seed of one sample from the loader seed, the sampler draw number and the dataset index,
+         * so the augmentation of a sample does not depend on which worker process it
+         * @param seed
+         * @param draw
+         * @param index
+         * @return uint64_t
+         * @ingroup LanternDataProcessing
+         */
+        inline uint64_t SampleSeed(const uint64_t &seed, const uint64_t &draw, const uint32_t &index) {
+            auto mix = [](uint64_t value) {
+                // splitmix64 finalizer
+                value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+                return value ^ (value >> 31);
+            };
+            return mix(mix(seed + draw * 0x9e3779b97f4a7c15ULL) + index);
+        }
+
+        /**
+         * @brief Get uniform float in [low, high)
+         * @param rng
+         * @param low
+         * @param high
+         * @return float
+         */
+        inline float UniformFloat(Pcg32 &rng, const float &low, const float &high) {
+            return low + (high - low) * static_cast<float>(rng.Next() >> 8) * (1.0f / 16777216.0f);
+        }
+
+        /**
+         * @brief Draw random resized crop of the image (area and aspect ratio drawn like torchvision
+         * RandomResizedCrop), fall back to the largest centered crop inside the ratio range
+         * @param augmentation
+         * @param sample_seed
+         * @param width source width
+         * @param height source height
+         * @return CropRect
+         * @ingroup LanternDataProcessing
+         */
+        inline CropRect DrawCrop(const Augmentation &augmentation, const uint64_t &sample_seed, const uint32_t &width, const uint32_t &height) {
+            Pcg32 rng(sample_seed, 1);
+            float area = static_cast<float>(width) * static_cast<float>(height);
+            float log_ratio_min = std::log(augmentation.crop_ratio_min), log_ratio_max = std::log(augmentation.crop_ratio_max);
+            for (uint32_t attempt = 0; attempt < 10; attempt++) {
+                float target = area * UniformFloat(rng, augmentation.crop_scale_min, augmentation.crop_scale_max);
+                float ratio = std::exp(UniformFloat(rng, log_ratio_min, log_ratio_max));
+                int64_t crop_width = std::llround(std::sqrt(target * ratio));
+                int64_t crop_height = std::llround(std::sqrt(target / ratio));
+                if (crop_width > 0 && crop_height > 0 && crop_width <= width && crop_height <= height) {
+                    CropRect rect;
+                    rect.width = static_cast<uint32_t>(crop_width);
+                    rect.height = static_cast<uint32_t>(crop_height);
+                    rect.x = rng.Bounded(width - rect.width + 1);
+                    rect.y = rng.Bounded(height - rect.height + 1);
+                    return rect;
+                }
+            }
+            CropRect rect{0, 0, width, height};
+            float ratio = static_cast<float>(width) / static_cast<float>(height);
+            if (ratio < augmentation.crop_ratio_min) {
+                rect.height = std::clamp<uint32_t>(static_cast<uint32_t>(std::lround(width / augmentation.crop_ratio_min)), 1, height);
+            } else if (ratio > augmentation.crop_ratio_max) {
+                rect.width = std::clamp<uint32_t>(static_cast<uint32_t>(std::lround(height * augmentation.crop_ratio_max)), 1, width);
+            }
+            rect.x = (width - rect.width) / 2;
+            rect.y = (height - rect.height) / 2;
+            return rect;
+        }
+
+        /**
+         * @brief Draw flip and brightness / contrast of one sample
+         * @param augmentation
+         * @param sample_seed
+         * @return PixelJitter
+         * @ingroup LanternDataProcessing
+         */
+        inline PixelJitter DrawJitter(const Augmentation &augmentation, const uint64_t &sample_seed) {
+            Pcg32 rng(sample_seed, 2);
+            PixelJitter jitter;
+            jitter.flip = UniformFloat(rng, 0.0f, 1.0f) < augmentation.flip_probability;
+            float shift = UniformFloat(rng, -augmentation.brightness, augmentation.brightness);
+            float factor = UniformFloat(rng, 1.0f - augmentation.contrast, 1.0f + augmentation.contrast);
+            jitter.gain = factor;
+            jitter.bias = 128.0f * (1.0f - factor) + 255.0f * shift;
+            return jitter;
+        }
+
+        /**
+         * @brief pshufb masks mirroring 16 interleaved pixels, indexed by [channels - 1][output vector][source vector]
+         */
+        struct MirrorMasks {
+            alignas(16) uint8_t mask[4][4][4][16];
+        };
+
+        constexpr MirrorMasks MakeMirrorMasks() {
+            MirrorMasks masks{};
+            for (int channels = 1; channels <= 4; channels++) {
+                for (int v = 0; v < channels; v++) {
+                    for (int u = 0; u < channels; u++) {
+                        for (int j = 0; j < 16; j++) {
+                            int k = 16 * v + j;
+                            int source = (15 - k / channels) * channels + k % channels;
+                            masks.mask[channels - 1][v][u][j] = source / 16 == u ? static_cast<uint8_t>(source % 16) : 0x80;
+                        }
+                    }
+                }
+            }
+            return masks;
+        }
+
+        inline constexpr MirrorMasks mirror_masks = MakeMirrorMasks();
+
+        /**
+         * @brief Mirror every row of the image in place
+         * @tparam channels
+         * @param image
+         * @param width
+         * @param height
+         */
+        template <uint32_t channels>
+        inline void FlipRows(uint8_t *image, const uint32_t &width, const uint32_t &height) {
+            for (uint32_t y = 0; y < height; y++) {
+                uint8_t *row = image + (size_t)y * width * channels;
+                uint32_t left = 0, right = width;
+#if defined(LANTERN_AUGMENT_X86)
+                // swap mirrored blocks of 16 pixels from both ends
+                auto mirror = [](const uint8_t *src, __m128i *out) {
+                    __m128i in[channels];
+                    for (uint32_t u = 0; u < channels; u++) {
+                        in[u] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16 * u));
+                    }
+                    for (uint32_t v = 0; v < channels; v++) {
+                        __m128i gathered = _mm_setzero_si128();
+                        for (uint32_t u = 0; u < channels; u++) {
+                            __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i *>(mirror_masks.mask[channels - 1][v][u]));
+                            gathered = _mm_or_si128(gathered, _mm_shuffle_epi8(in[u], mask));
+                        }
+                        out[v] = gathered;
+                    }
+                };
+                for (; right - left >= 32; left += 16, right -= 16) {
+                    __m128i head[channels], tail[channels];
+                    mirror(row + (size_t)left * channels, head);
+                    mirror(row + (size_t)(right - 16) * channels, tail);
+                    for (uint32_t v = 0; v < channels; v++) {
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(row + (size_t)left * channels + 16 * v), tail[v]);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(row + (size_t)(right - 16) * channels + 16 * v), head[v]);
+                    }
+                }
+#elif defined(LANTERN_AUGMENT_NEON)
+                // swap mirrored blocks of 16 pixels from both ends, channels are split by the structured load
+                auto mirror = [](uint8x16_t value) {
+                    value = vrev64q_u8(value);
+                    return vextq_u8(value, value, 8);
+                };
+                for (; right - left >= 32; left += 16, right -= 16) {
+                    uint8_t *head = row + (size_t)left * channels, *tail = row + (size_t)(right - 16) * channels;
+                    if constexpr (channels == 1) {
+                        uint8x16_t a = vld1q_u8(head), b = vld1q_u8(tail);
+                        vst1q_u8(head, mirror(b));
+                        vst1q_u8(tail, mirror(a));
+                    } else if constexpr (channels == 2) {
+                        uint8x16x2_t a = vld2q_u8(head), b = vld2q_u8(tail);
+                        for (uint32_t c = 0; c < 2; c++) {
+                            uint8x16_t t = mirror(a.val[c]);
+                            a.val[c] = mirror(b.val[c]);
+                            b.val[c] = t;
+                        }
+                        vst2q_u8(head, a);
+                        vst2q_u8(tail, b);
+                    } else if constexpr (channels == 3) {
+                        uint8x16x3_t a = vld3q_u8(head), b = vld3q_u8(tail);
+                        for (uint32_t c = 0; c < 3; c++) {
+                            uint8x16_t t = mirror(a.val[c]);
+                            a.val[c] = mirror(b.val[c]);
+                            b.val[c] = t;
+                        }
+                        vst3q_u8(head, a);
+                        vst3q_u8(tail, b);
+                    } else {
+                        uint8x16x4_t a = vld4q_u8(head), b = vld4q_u8(tail);
+                        for (uint32_t c = 0; c < 4; c++) {
+                            uint8x16_t t = mirror(a.val[c]);
+                            a.val[c] = mirror(b.val[c]);
+                            b.val[c] = t;
+                        }
+                        vst4q_u8(head, a);
+                        vst4q_u8(tail, b);
+                    }
+                }
+#endif
+                for (; right - left >= 2; left++, right--) {
+                    uint8_t *a = row + (size_t)left * channels, *b = row + (size_t)(right - 1) * channels;
+                    for (uint32_t c = 0; c < channels; c++) {
+                        std::swap(a[c], b[c]);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Mirror the image horizontally in place
+         * @param image HWC
+         * @param width
+         * @param height
+         * @param channels 1 to 4
+         * @ingroup LanternDataProcessing
+         */
+        inline void FlipHorizontal(uint8_t *image, const uint32_t &width, const uint32_t &height, const uint32_t &channels) {
+            switch (channels) {
+            case 1:
+                FlipRows<1>(image, width, height);
+                break;
+            case 2:
+                FlipRows<2>(image, width, height);
+                break;
+            case 3:
+                FlipRows<3>(image, width, height);
+                break;
+            default:
+                FlipRows<4>(image, width, height);
+                break;
+            }
+        }
+
+        /**
+         * @brief Apply pixel * gain + bias to every color byte in place, rounded to nearest even and saturated.
+         * The alpha channel of 2 and 4 channels images is kept
+         * @param data HWC
+         * @param total total bytes
+         * @param channels 1 to 4
+         * @param gain
+         * @param bias
+         * @ingroup LanternDataProcessing
+         */
+        inline void AdjustGainBias(uint8_t *data, const size_t &total, const uint32_t &channels, const float &gain, const float &bias) {
+            size_t i = 0;
+            bool has_alpha = channels == 2 || channels == 4;
+#if defined(LANTERN_AUGMENT_X86) || defined(LANTERN_AUGMENT_NEON)
+            // 16 bytes always start at a pixel boundary for 2 and 4 channels, so one alpha mask fit every block
+            alignas(16) uint8_t alpha[16];
+            for (uint32_t k = 0; k < 16; k++) {
+                alpha[k] = has_alpha && k % channels == channels - 1 ? 0xff : 0x00;
+            }
+#endif
+#if defined(LANTERN_AUGMENT_X86)
+            __m128 scale = _mm_set1_ps(gain), offset = _mm_set1_ps(bias);
+            __m128i alpha_mask = _mm_load_si128(reinterpret_cast<const __m128i *>(alpha));
+            for (; i + 16 <= total; i += 16) {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i lanes[4];
+                lanes[0] = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes)), scale), offset));
+                lanes[1] = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4))), scale), offset));
+                lanes[2] = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8))), scale), offset));
+                lanes[3] = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12))), scale), offset));
+                __m128i packed = _mm_packus_epi16(_mm_packus_epi32(lanes[0], lanes[1]), _mm_packus_epi32(lanes[2], lanes[3]));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_blendv_epi8(packed, bytes, alpha_mask));
+            }
+#elif defined(LANTERN_AUGMENT_NEON)
+            float32x4_t scale = vdupq_n_f32(gain), offset = vdupq_n_f32(bias);
+            uint8x16_t alpha_mask = vld1q_u8(alpha);
+            for (; i + 16 <= total; i += 16) {
+                uint8x16_t bytes = vld1q_u8(data + i);
+                uint16x8_t lo = vmovl_u8(vget_low_u8(bytes)), hi = vmovl_u8(vget_high_u8(bytes));
+                auto lane = [&](const uint16x4_t &value) {
+                    float32x4_t x = vaddq_f32(vmulq_f32(vcvtq_f32_u32(vmovl_u16(value)), scale), offset);
+                    return vqmovun_s32(vcvtnq_s32_f32(x));
+                };
+                uint16x8_t low = vcombine_u16(lane(vget_low_u16(lo)), lane(vget_high_u16(lo)));
+                uint16x8_t high = vcombine_u16(lane(vget_low_u16(hi)), lane(vget_high_u16(hi)));
+                vst1q_u8(data + i, vbslq_u8(alpha_mask, bytes, vcombine_u8(vqmovn_u16(low), vqmovn_u16(high))));
+            }
+#endif
+            for (; i < total; i++) {
+                if (has_alpha && i % channels == channels - 1) {
+                    continue;
+                }
+                long value = std::lrint(static_cast<float>(data[i]) * gain + bias);
+                data[i] = static_cast<uint8_t>(std::clamp<long>(value, 0, 255));
+            }
+        }
+
+    }
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include "../pch.h"
+
+/**
+ * @brief Persistent cache of resized images on disk. Every entry is the raw pixels after resize,
+ * addressed by the source path, its modification time and file size, and the target shape, so a
+ * changed source file or another output shape never hit a stale entry. Cache errors are never
+ * fatal, a missing or broken entry is only a miss.
+ * @ingroup LanternFile
+ */
+class ImageDiskCache
+{
+public:
+    /**
+     * @brief Identity of one cache entry
+     */
+    struct Key
+    {
+        std::string path;
+        int64_t mtime = 0;
+        uint64_t file_size = 0;
+        uint32_t width = 0, height = 0, channels = 0;
+    };
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t width, height, channels;
+        int64_t mtime;
+        uint64_t file_size;
+        uint64_t path_length;
+    };
+
+    static constexpr uint32_t magic = 0x3143494cu; // "LIC1"
+
+    std::filesystem::path directory;
+
+    /**
+     * @brief FNV-1a hash of the key, used as entry file name
+     * @param key
+     * @return uint64_t
+     */
+    static uint64_t Hash(const Key &key)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        auto mix = [&](const void *data, const size_t &size)
+        {
+            const uint8_t *bytes = static_cast<const uint8_t *>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                hash = (hash ^ bytes[i]) * 1099511628211ULL;
+            }
+        };
+        mix(key.path.data(), key.path.size());
+        mix(&key.mtime, sizeof(key.mtime));
+        mix(&key.file_size, sizeof(key.file_size));
+        mix(&key.width, sizeof(key.width));
+        mix(&key.height, sizeof(key.height));
+        mix(&key.channels, sizeof(key.channels));
+        return hash;
+    }
+
+    /**
+     * @brief Random value drawn once per process, thread id alone repeat across processes sharing the cache directory
+     * @return uint64_t
+     */
+    static uint64_t ProcessToken()
+    {
+        static const uint64_t token = []()
+        {
+            std::random_device device;
+            return (static_cast<uint64_t>(device()) << 32) ^ device() ^
+                   static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        }();
+        return token;
+    }
+
+    std::filesystem::path EntryPath(const Key &key) const
+    {
+        return this->directory / std::format("{:016x}.lic", Hash(key));
+    }
+
+public:
+    ImageDiskCache() {}
+
+    /**
+     * @brief Use the directory as cache, it is created when missing
+     * @param _directory
+     */
+    void Open(const std::string &_directory)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(_directory, error);
+        if (error || !std::filesystem::is_directory(_directory))
+        {
+            throw std::runtime_error(std::format("Error ImageDiskCache, cannot use \"{}\" as cache directory", _directory));
+        }
+        this->directory = _directory;
+    }
+
+    void Close()
+    {
+        this->directory.clear();
+    }
+
+    bool IsOpen() const
+    {
+        return !this->directory.empty();
+    }
+
+    /**
+     * @brief Build the key of a source image for the target shape
+     * @param _path
+     * @param _width
+     * @param _height
+     * @param _channels
+     * @param key
+     * @return bool false when the source file cannot be stat
+     */
+    static bool MakeKey(const std::string &_path, const uint32_t &_width, const uint32_t &_height, const uint32_t &_channels, Key &key)
+    {
+        std::error_code error;
+        auto mtime = std::filesystem::last_write_time(_path, error);
+        if (error)
+        {
+            return false;
+        }
+        uint64_t file_size = std::filesystem::file_size(_path, error);
+        if (error)
+        {
+            return false;
+        }
+        key.path = _path;
+        key.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+        key.file_size = file_size;
+        key.width = _width;
+        key.height = _height;
+        key.channels = _channels;
+        return true;
+    }
+
+    /**
+     * @brief Read the cached pixels of the key into destination
+     * @param key
+     * @param destination
+     * @param size total bytes of the image
+     * @return bool false on miss
+     */
+    bool Load(const Key &key, uint8_t *destination, const size_t &size) const
+    {
+        std::ifstream file(this->EntryPath(key), std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        Header header;
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        {
+            return false;
+        }
+        if (header.magic != magic || header.width != key.width || header.height != key.height || header.channels != key.channels ||
+            header.mtime != key.mtime || header.file_size != key.file_size || header.path_length != key.path.size() ||
+            (size_t)key.width * key.height * key.channels != size)
+        {
+            return false;
+        }
+        // the path is stored to reject hash collisions
+        std::string path(header.path_length, '\0');
+        if (!file.read(path.data(), path.size()) || path != key.path)
+        {
+            return false;
+        }
+        return static_cast<bool>(file.read(reinterpret_cast<char *>(destination), size));
+    }
+
+    /**
+     * @brief Write the pixels of the key, the entry is written to temporary file then renamed
+     * so concurrent readers never see partial entry
+     * @param key
+     * @param source
+     * @param size total bytes of the image
+     */
+    void Store(const Key &key, const uint8_t *source, const size_t &size) const
+    {
+        std::filesystem::path entry = this->EntryPath(key);
+        std::filesystem::path temporary = entry;
+        temporary += std::format(".{:016x}.{}.tmp", ProcessToken(), std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                return;
+            }
+            Header header{magic, key.width, key.height, key.channels, key.mtime, key.file_size, key.path.size()};
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(key.path.data(), key.path.size());
+            file.write(reinterpret_cast<const char *>(source), size);
+            if (!file)
+            {
+                file.close();
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                return;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, entry, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+        }
+    }
+};
@@ -0,0 +1,564 @@
+#pragma once
+#include "../pch.h"
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define LANTERN_CONVERT_F16C 1
+#endif
+#if defined(__AVX512F__) || defined(__AVX2__)
+#define LANTERN_CONVERT_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LANTERN_CONVERT_NEON 1
+#endif
+
+namespace lantern {
+
+    namespace data {
+
+        /**
+         * @brief Memory layout of a float image, read as row-major from left to right
+         * @ingroup LanternDataProcessing
+         */
+        enum class TensorLayout {
+            HWC, // interleaved, same order as the decoded pixels
+            CHW, // one plane per channel, every plane row by row
+            CWH  // one plane per channel, every plane column by column, the native layout of af::array(height, width, channels)
+        };
+
+        /**
+         * @brief Per channel normalization, every value become (pixel * scale - mean[c]) / stddev[c]
+         * @ingroup LanternDataProcessing
+         */
+        struct Normalization {
+            float scale = 1.0f / 255.0f;
+            std::array<float, 4> mean{0.0f, 0.0f, 0.0f, 0.0f};
+            std::array<float, 4> stddev{1.0f, 1.0f, 1.0f, 1.0f};
+        };
+
+        /**
+         * @brief pshufb masks gathering one channel of 16 interleaved pixels from the 16 bytes source vectors,
+         * indexed by [channels - 1][channel][source vector]
+         */
+        struct DeinterleaveMasks {
+            alignas(16) uint8_t mask[4][4][4][16];
+        };
+
+        constexpr DeinterleaveMasks MakeDeinterleaveMasks() {
+            DeinterleaveMasks masks{};
+            for (int channels = 2; channels <= 4; channels++) {
+                for (int c = 0; c < channels; c++) {
+                    for (int v = 0; v < channels; v++) {
+                        for (int j = 0; j < 16; j++) {
+                            int source = channels * j + c - 16 * v;
+                            masks.mask[channels - 1][c][v][j] = (source >= 0 && source < 16) ? static_cast<uint8_t>(source) : 0x80;
+                        }
+                    }
+                }
+            }
+            return masks;
+        }
+
+        inline constexpr DeinterleaveMasks deinterleave_masks = MakeDeinterleaveMasks();
+
+        /**
+         * @brief Convert 16 interleaved pixels, channel c of pixel i is written to out[c][i]
+         * @tparam channels
+         * @param src 16 * channels bytes
+         * @param a per channel multiplier
+         * @param b per channel offset
+         * @param out 16 floats per channel
+         */
+        template <uint32_t channels>
+        inline void ConvertBlock16(const uint8_t *src, const float *a, const float *b, float *const *out) {
+#if defined(LANTERN_CONVERT_X86)
+            __m128i channel[channels];
+            if constexpr (channels == 1) {
+                channel[0] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            } else {
+                __m128i in[4];
+                for (uint32_t v = 0; v < channels; v++) {
+                    in[v] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16 * v));
+                }
+                for (uint32_t c = 0; c < channels; c++) {
+                    __m128i gathered = _mm_setzero_si128();
+                    for (uint32_t v = 0; v < channels; v++) {
+                        __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i *>(deinterleave_masks.mask[channels - 1][c][v]));
+                        gathered = _mm_or_si128(gathered, _mm_shuffle_epi8(in[v], mask));
+                    }
+                    channel[c] = gathered;
+                }
+            }
+            for (uint32_t c = 0; c < channels; c++) {
+#if defined(__AVX512F__)
+                __m512 x = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(channel[c]));
+                _mm512_storeu_ps(out[c], _mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(a[c])), _mm512_set1_ps(b[c])));
+#else
+                __m256 scale = _mm256_set1_ps(a[c]), offset = _mm256_set1_ps(b[c]);
+                __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(channel[c]));
+                __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(channel[c], 8)));
+                _mm256_storeu_ps(out[c], _mm256_add_ps(_mm256_mul_ps(lo, scale), offset));
+                _mm256_storeu_ps(out[c] + 8, _mm256_add_ps(_mm256_mul_ps(hi, scale), offset));
+#endif
+            }
+#elif defined(LANTERN_CONVERT_NEON)
+            uint8x16_t channel[channels];
+            if constexpr (channels == 1) {
+                channel[0] = vld1q_u8(src);
+            } else if constexpr (channels == 2) {
+                uint8x16x2_t in = vld2q_u8(src);
+                channel[0] = in.val[0];
+                channel[1] = in.val[1];
+            } else if constexpr (channels == 3) {
+                uint8x16x3_t in = vld3q_u8(src);
+                channel[0] = in.val[0];
+                channel[1] = in.val[1];
+                channel[2] = in.val[2];
+            } else {
+                uint8x16x4_t in = vld4q_u8(src);
+                channel[0] = in.val[0];
+                channel[1] = in.val[1];
+                channel[2] = in.val[2];
+                channel[3] = in.val[3];
+            }
+            for (uint32_t c = 0; c < channels; c++) {
+                float32x4_t scale = vdupq_n_f32(a[c]), offset = vdupq_n_f32(b[c]);
+                uint16x8_t lo = vmovl_u8(vget_low_u8(channel[c]));
+                uint16x8_t hi = vmovl_u8(vget_high_u8(channel[c]));
+                vst1q_f32(out[c], vmlaq_f32(offset, vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale));
+                vst1q_f32(out[c] + 4, vmlaq_f32(offset, vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale));
+                vst1q_f32(out[c] + 8, vmlaq_f32(offset, vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale));
+                vst1q_f32(out[c] + 12, vmlaq_f32(offset, vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale));
+            }
+#else
+            for (uint32_t c = 0; c < channels; c++) {
+                for (uint32_t i = 0; i < 16; i++) {
+                    out[c][i] = static_cast<float>(src[i * channels + c]) * a[c] + b[c];
+                }
+            }
+#endif
+        }
+
+        /**
+         * @brief Convert interleaved bytes keeping their order, value i use channel i % channels
+         * @param src
+         * @param dst
+         * @param total total values, width * height * channels
+         * @param channels
+         * @param a per channel multiplier
+         * @param b per channel offset
+         */
+        inline void ConvertInterleaved(const uint8_t *src, float *dst, const size_t &total, const uint32_t &channels, const float *a, const float *b) {
+            size_t i = 0;
+#if defined(LANTERN_CONVERT_X86) || defined(LANTERN_CONVERT_NEON)
+            // 48 values hold a whole number of pixels for every channel count and of vectors for every width
+            alignas(64) float pattern_a[48], pattern_b[48];
+            for (uint32_t k = 0; k < 48; k++) {
+                pattern_a[k] = a[k % channels];
+                pattern_b[k] = b[k % channels];
+            }
+            for (; i + 48 <= total; i += 48) {
+#if defined(__AVX512F__)
+                for (uint32_t k = 0; k < 48; k += 16) {
+                    __m512 x = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + k))));
+                    _mm512_storeu_ps(dst + i + k, _mm512_add_ps(_mm512_mul_ps(x, _mm512_load_ps(pattern_a + k)), _mm512_load_ps(pattern_b + k)));
+                }
+#elif defined(LANTERN_CONVERT_X86)
+                for (uint32_t k = 0; k < 48; k += 8) {
+                    __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i + k))));
+                    _mm256_storeu_ps(dst + i + k, _mm256_add_ps(_mm256_mul_ps(x, _mm256_load_ps(pattern_a + k)), _mm256_load_ps(pattern_b + k)));
+                }
+#else
+                for (uint32_t k = 0; k < 48; k += 16) {
+                    uint8x16_t bytes = vld1q_u8(src + i + k);
+                    uint16x8_t lo = vmovl_u8(vget_low_u8(bytes));
+                    uint16x8_t hi = vmovl_u8(vget_high_u8(bytes));
+                    float32x4_t x[4] = {vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))),
+                                        vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi)))};
+                    for (uint32_t q = 0; q < 4; q++) {
+                        vst1q_f32(dst + i + k + 4 * q, vmlaq_f32(vld1q_f32(pattern_b + k + 4 * q), x[q], vld1q_f32(pattern_a + k + 4 * q)));
+                    }
+                }
+#endif
+            }
+#endif
+            // i is always at a pixel boundary here
+            for (; i < total; i += channels) {
+                for (uint32_t c = 0; c < channels; c++) {
+                    dst[i + c] = static_cast<float>(src[i + c]) * a[c] + b[c];
+                }
+            }
+        }
+
+        /**
+         * @brief Convert HWC bytes into CHW floats
+         * @tparam channels
+         * @param src
+         * @param dst
+         * @param plane width * height
+         * @param a per channel multiplier
+         * @param b per channel offset
+         */
+        template <uint32_t channels>
+        inline void ConvertPlanar(const uint8_t *src, float *dst, const size_t &plane, const float *a, const float *b) {
+            size_t p = 0;
+            for (; p + 16 <= plane; p += 16) {
+                float *out[channels];
+                for (uint32_t c = 0; c < channels; c++) {
+                    out[c] = dst + c * plane + p;
+                }
+                ConvertBlock16<channels>(src + p * channels, a, b, out);
+            }
+            for (; p < plane; p++) {
+                for (uint32_t c = 0; c < channels; c++) {
+                    dst[c * plane + p] = static_cast<float>(src[p * channels + c]) * a[c] + b[c];
+                }
+            }
+        }
+
+#if defined(LANTERN_CONVERT_X86)
+        /**
+         * @brief Transpose 8x8 floats held in 8 registers, row i become column i
+         * @param rows
+         */
+        inline void Transpose8x8(__m256 *rows) {
+            __m256 t[8], u[8];
+            for (uint32_t i = 0; i < 8; i += 2) {
+                t[i] = _mm256_unpacklo_ps(rows[i], rows[i + 1]);
+                t[i + 1] = _mm256_unpackhi_ps(rows[i], rows[i + 1]);
+            }
+            for (uint32_t i = 0; i < 8; i += 4) {
+                u[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+                u[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+                u[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+                u[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+            }
+            for (uint32_t i = 0; i < 4; i++) {
+                rows[i] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+                rows[i + 4] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+            }
+        }
+#endif
+
+        /**
+         * @brief Convert HWC bytes into CWH floats. Tiles of 8 rows x 16 pixels are converted into a small
+         * buffer then written transposed, so every store is a run of 8 contiguous floats of one column
+         * @tparam channels
+         * @param src
+         * @param dst
+         * @param width
+         * @param height
+         * @param a per channel multiplier
+         * @param b per channel offset
+         */
+        template <uint32_t channels>
+        inline void ConvertColumnMajor(const uint8_t *src, float *dst, const uint32_t &width, const uint32_t &height, const float *a, const float *b) {
+            constexpr uint32_t tile_rows = 8, tile_cols = 16;
+            alignas(64) float tile[channels][tile_rows][tile_cols];
+            size_t plane = (size_t)width * height;
+            auto convert_pixel = [&](const uint32_t &x, const uint32_t &y) {
+                const uint8_t *pixel = src + ((size_t)y * width + x) * channels;
+                for (uint32_t c = 0; c < channels; c++) {
+                    dst[c * plane + (size_t)x * height + y] = static_cast<float>(pixel[c]) * a[c] + b[c];
+                }
+            };
+            uint32_t y0 = 0;
+            for (; y0 + tile_rows <= height; y0 += tile_rows) {
+                uint32_t x0 = 0;
+                for (; x0 + tile_cols <= width; x0 += tile_cols) {
+                    for (uint32_t t = 0; t < tile_rows; t++) {
+                        float *out[channels];
+                        for (uint32_t c = 0; c < channels; c++) {
+                            out[c] = tile[c][t];
+                        }
+                        ConvertBlock16<channels>(src + ((size_t)(y0 + t) * width + x0) * channels, a, b, out);
+                    }
+                    for (uint32_t c = 0; c < channels; c++) {
+#if defined(LANTERN_CONVERT_X86)
+                        for (uint32_t x = 0; x < tile_cols; x += 8) {
+                            __m256 rows[8];
+                            for (uint32_t t = 0; t < tile_rows; t++) {
+                                rows[t] = _mm256_load_ps(tile[c][t] + x);
+                            }
+                            Transpose8x8(rows);
+                            for (uint32_t k = 0; k < 8; k++) {
+                                _mm256_storeu_ps(dst + c * plane + (size_t)(x0 + x + k) * height + y0, rows[k]);
+                            }
+                        }
+#else
+                        for (uint32_t x = 0; x < tile_cols; x++) {
+                            float *column = dst + c * plane + (size_t)(x0 + x) * height + y0;
+                            for (uint32_t t = 0; t < tile_rows; t++) {
+                                column[t] = tile[c][t][x];
+                            }
+                        }
+#endif
+                    }
+                }
+                for (uint32_t x = x0; x < width; x++) {
+                    for (uint32_t y = y0; y < y0 + tile_rows; y++) {
+                        convert_pixel(x, y);
+                    }
+                }
+            }
+            for (uint32_t x = 0; x < width; x++) {
+                for (uint32_t y = y0; y < height; y++) {
+                    convert_pixel(x, y);
+                }
+            }
+        }
+
+        /**
+         * @brief Convert IEEE float into half float bits, rounded to nearest even
+         * @param value
+         * @return uint16_t
+         * @ingroup LanternDataProcessing
+         */
+        inline uint16_t FloatToHalf(const float &value) {
+#if defined(LANTERN_CONVERT_F16C)
+            return static_cast<uint16_t>(_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            uint32_t sign = (bits >> 16) & 0x8000u;
+            bits &= 0x7fffffffu;
+            uint16_t half;
+            if (bits >= (127u + 16u) << 23) {
+                // too large for half, infinity or NaN
+                half = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+            } else if (bits < 113u << 23) {
+                // subnormal or zero, the float addition round the 10 mantissa bits for us
+                constexpr uint32_t magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+                float magic, shifted;
+                std::memcpy(&magic, &magic_bits, sizeof(magic));
+                std::memcpy(&shifted, &bits, sizeof(shifted));
+                shifted += magic;
+                std::memcpy(&bits, &shifted, sizeof(bits));
+                half = static_cast<uint16_t>(bits - magic_bits);
+            } else {
+                uint32_t odd = (bits >> 13) & 1u;
+                bits += ((15u - 127u) << 23) + 0xfffu + odd;
+                half = static_cast<uint16_t>(bits >> 13);
+            }
+            return static_cast<uint16_t>(half | sign);
+#endif
+        }
+
+        /**
+         * @brief Element type of converted images
+         * @ingroup LanternDataProcessing
+         */
+        enum class PixelType {
+            UInt8,   // raw pixels
+            UInt16,  // raw pixels stretched to the 16 bit range
+            Float16, // normalized, stored as half float bits
+            Float32  // normalized
+        };
+
+        /**
+         * @brief Get ArrayFire type of the pixel type
+         * @param type
+         * @return af_dtype
+         * @ingroup LanternDataProcessing
+         */
+        constexpr af_dtype AFTypeOf(const PixelType &type) {
+            switch (type) {
+            case PixelType::UInt8:
+                return u8;
+            case PixelType::UInt16:
+                return u16;
+            case PixelType::Float16:
+                return f16;
+            default:
+                return f32;
+            }
+        }
+
+        /**
+         * @brief Get bytes of one element of the pixel type
+         * @param type
+         * @return size_t
+         * @ingroup LanternDataProcessing
+         */
+        constexpr size_t SizeOf(const PixelType &type) {
+            return type == PixelType::UInt8 ? 1 : type == PixelType::Float32 ? 4 : 2;
+        }
+
+        /**
+         * @brief Compile time pixel format policy: total channels, element type and layout of a converted image.
+         * Strides are in elements, so the offset of channel c of pixel (x, y) is x * StrideX + y * StrideY + c * StrideC
+         * @tparam Channels 1 grayscale, 2 grayscale alpha, 3 RGB, 4 RGBA
+         * @tparam Type
+         * @tparam Layout
+         * @ingroup LanternDataProcessing
+         */
+        template <uint32_t Channels, PixelType Type = PixelType::Float32, TensorLayout Layout = TensorLayout::CWH>
+        struct PixelFormat {
+            static_assert(Channels >= 1 && Channels <= 4, "PixelFormat, channels must be 1 to 4");
+
+            static constexpr uint32_t channels = Channels;
+            static constexpr PixelType type = Type;
+            static constexpr TensorLayout layout = Layout;
+            static constexpr af_dtype af_type = AFTypeOf(Type);
+            using value_type = std::conditional_t<Type == PixelType::UInt8, uint8_t, std::conditional_t<Type == PixelType::Float32, float, uint16_t>>;
+
+            static constexpr size_t StrideX([[maybe_unused]] const uint32_t &width, const uint32_t &height) {
+                return Layout == TensorLayout::HWC ? Channels : Layout == TensorLayout::CHW ? 1 : height;
+            }
+
+            static constexpr size_t StrideY(const uint32_t &width, [[maybe_unused]] const uint32_t &height) {
+                return Layout == TensorLayout::HWC ? (size_t)width * Channels : Layout == TensorLayout::CHW ? width : 1;
+            }
+
+            static constexpr size_t StrideC(const uint32_t &width, const uint32_t &height) {
+                return Layout == TensorLayout::HWC ? 1 : (size_t)width * height;
+            }
+
+            static constexpr size_t ImageSize(const uint32_t &width, const uint32_t &height) {
+                return (size_t)width * height * Channels;
+            }
+        };
+
+        using PixelGray = PixelFormat<1>;
+        using PixelRGB = PixelFormat<3>;
+        using PixelRGBA = PixelFormat<4>;
+
+        /**
+         * @brief Fold (pixel * scale - mean) / stddev into pixel * a + b
+         * @param normalization
+         * @param channels
+         * @param a
+         * @param b
+         */
+        inline void NormalizationCoefficients(const Normalization &normalization, const uint32_t &channels, float *a, float *b) {
+            for (uint32_t c = 0; c < channels; c++) {
+                if (normalization.stddev[c] == 0.0f) {
+                    throw std::runtime_error(std::format("Error ConvertImage, stddev of channel {} is zero", c));
+                }
+                a[c] = normalization.scale / normalization.stddev[c];
+                b[c] = -normalization.mean[c] / normalization.stddev[c];
+            }
+        }
+
+        /**
+         * @brief Convert one HWC uint8 image into the pixel format in a single pass, every format is its own
+         * instantiation so channels, strides and element conversion are constants of the inner loop.
+         *
+         * Float32 uses AVX-512, AVX2 or NEON when the build target enable it (-mavx2, -march=native, /arch:AVX2,
+         * /arch:AVX512) and plain loops otherwise, every path give the same values. Integer types keep the raw
+         * pixels and ignore normalization.
+         * @tparam Format PixelFormat
+         * @param src width * height * channels bytes, HWC
+         * @param dst width * height * channels elements, must not overlap src
+         * @param width
+         * @param height
+         * @param normalization
+         * @ingroup LanternDataProcessing
+         */
+        template <typename Format>
+        inline void ConvertImage(const uint8_t *src, typename Format::value_type *dst, const uint32_t &width, const uint32_t &height,
+                                 const Normalization &normalization = Normalization{}) {
+            constexpr uint32_t channels = Format::channels;
+            float a[channels], b[channels];
+            if constexpr (Format::type == PixelType::Float32 || Format::type == PixelType::Float16) {
+                NormalizationCoefficients(normalization, channels, a, b);
+            }
+            size_t plane = (size_t)width * height;
+
+            if constexpr (Format::type == PixelType::Float32) {
+                if constexpr (Format::layout == TensorLayout::HWC || channels == 1) {
+                    if constexpr (Format::layout == TensorLayout::CWH && channels == 1) {
+                        ConvertColumnMajor<1>(src, dst, width, height, a, b);
+                    } else {
+                        ConvertInterleaved(src, dst, plane * channels, channels, a, b);
+                    }
+                } else if constexpr (Format::layout == TensorLayout::CHW) {
+                    ConvertPlanar<channels>(src, dst, plane, a, b);
+                } else {
+                    ConvertColumnMajor<channels>(src, dst, width, height, a, b);
+                }
+            } else if constexpr (Format::type == PixelType::UInt8 && (Format::layout == TensorLayout::HWC || (Format::layout == TensorLayout::CHW && channels == 1))) {
+                std::memcpy(dst, src, plane * channels);
+            } else {
+                const size_t stride_x = Format::StrideX(width, height), stride_y = Format::StrideY(width, height), stride_c = Format::StrideC(width, height);
+                for (uint32_t y = 0; y < height; y++) {
+                    const uint8_t *row = src + (size_t)y * width * channels;
+                    typename Format::value_type *out = dst + y * stride_y;
+                    for (uint32_t x = 0; x < width; x++) {
+                        for (uint32_t c = 0; c < channels; c++) {
+                            uint8_t value = row[x * channels + c];
+                            typename Format::value_type &element = out[x * stride_x + c * stride_c];
+                            if constexpr (Format::type == PixelType::UInt8) {
+                                element = value;
+                            } else if constexpr (Format::type == PixelType::UInt16) {
+                                element = static_cast<uint16_t>(value * 257u);
+                            } else {
+                                element = FloatToHalf(static_cast<float>(value) * a[c] + b[c]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Type erased ConvertImage, dst hold the element type of the format
+         * @ingroup LanternDataProcessing
+         */
+        using ImageConverter = void (*)(const uint8_t *src, void *dst, const uint32_t &width, const uint32_t &height, const Normalization &normalization);
+
+        template <typename Format>
+        inline void ConvertImageErased(const uint8_t *src, void *dst, const uint32_t &width, const uint32_t &height, const Normalization &normalization) {
+            ConvertImage<Format>(src, static_cast<typename Format::value_type *>(dst), width, height, normalization);
+        }
+
+        template <PixelType Type, TensorLayout Layout>
+        constexpr std::array<ImageConverter, 4> ConvertersOf() {
+            return {&ConvertImageErased<PixelFormat<1, Type, Layout>>, &ConvertImageErased<PixelFormat<2, Type, Layout>>,
+                    &ConvertImageErased<PixelFormat<3, Type, Layout>>, &ConvertImageErased<PixelFormat<4, Type, Layout>>};
+        }
+
+        template <PixelType Type>
+        constexpr std::array<std::array<ImageConverter, 4>, 3> ConvertersOf() {
+            return {ConvertersOf<Type, TensorLayout::HWC>(), ConvertersOf<Type, TensorLayout::CHW>(), ConvertersOf<Type, TensorLayout::CWH>()};
+        }
+
+        /**
+         * @brief Get the instantiation of ConvertImage for a format only known at runtime, resolve it once
+         * and call it for every image
+         * @param channels 1 to 4
+         * @param type
+         * @param layout
+         * @return ImageConverter
+         * @ingroup LanternDataProcessing
+         */
+        inline ImageConverter ConverterOf(const uint32_t &channels, const PixelType &type, const TensorLayout &layout) {
+            if (channels == 0 || channels > 4) {
+                throw std::runtime_error(std::format("Error ConverterOf, unsupported channels {}", channels));
+            }
+            // indexed by [type][layout][channels - 1]
+            static constexpr std::array<std::array<std::array<ImageConverter, 4>, 3>, 4> converters = {
+                ConvertersOf<PixelType::UInt8>(), ConvertersOf<PixelType::UInt16>(), ConvertersOf<PixelType::Float16>(), ConvertersOf<PixelType::Float32>()};
+            return converters[static_cast<size_t>(type)][static_cast<size_t>(layout)][channels - 1];
+        }
+
+        /**
+         * @brief Convert one HWC uint8 image into normalized float32, runtime form of ConvertImage
+         * @param src width * height * channels bytes, HWC
+         * @param dst width * height * channels floats, must not overlap src
+         * @param width
+         * @param height
+         * @param channels 1 to 4
+         * @param layout
+         * @param normalization
+         * @ingroup LanternDataProcessing
+         */
+        inline void ConvertToFloat(const uint8_t *src, float *dst, const uint32_t &width, const uint32_t &height, const uint32_t &channels,
+                                   const TensorLayout &layout, const Normalization &normalization = Normalization{}) {
+            ConverterOf(channels, PixelType::Float32, layout)(src, dst, width, height, normalization);
+        }
+
+    }
+
+}
@@ -2,6 +2,7 @@
 #include "../pch.h"
 #include "Vector.h"
 #include <unordered_set>
+#include <algorithm>
 
 /**
  * @defgroup LanternDataProcessing An utility function to manipulate or generate data
@@ -65,15 +66,14 @@ namespace lantern {
         }
 
         /**
-         * @brief Get the Random Sample Class Index
-         * @tparam batch_size 
+         * @brief Get the Random Sample Class Index with batch size known at runtime
          * @param batch_index
+         * @param batch_size
          * @param each_size
          * @param total_size_of_class
          * @ingroup LanternDataProcessing
          */
-        template <uint32_t batch_size>
-        inline void GetRandomSampleClassIndex(lantern::utility::Vector<uint32_t>& batch_index,lantern::utility::Vector<uint32_t>& each_size, const uint32_t& total_size_of_class){
+        inline void GetRandomSampleClassIndex(lantern::utility::Vector<uint32_t>& batch_index, const uint32_t& batch_size, lantern::utility::Vector<uint32_t>& each_size, const uint32_t& total_size_of_class){
             
             batch_index.clean();
             std::random_device rd;
@@ -86,7 +86,7 @@ namespace lantern {
                 }
 
                 uint32_t* ptr = batch_index.getData();
-                std::shuffle(&ptr[0],&ptr[batch_index.size() - 1],rg);
+                std::shuffle(&ptr[0],&ptr[batch_index.size()],rg);
                 return;
             }
             
@@ -124,6 +124,526 @@ namespace lantern {
             }
 
         }
+
+        /**
+         * @brief Get the Random Sample Class Index
+         * @tparam batch_size 
+         * @param batch_index
+         * @param each_size
+         * @param total_size_of_class
+         * @ingroup LanternDataProcessing
+         */
+        template <uint32_t batch_size>
+        inline void GetRandomSampleClassIndex(lantern::utility::Vector<uint32_t>& batch_index,lantern::utility::Vector<uint32_t>& each_size, const uint32_t& total_size_of_class){
+            GetRandomSampleClassIndex(batch_index, batch_size, each_size, total_size_of_class);
+        }
+
+        /**
+         * @brief Small PCG32 random generator, the state is two integer so it can be saved and restored,
+         * and the output does not depend on the standard library implementation
+         * @ingroup LanternDataProcessing
+         */
+        class Pcg32 {
+        private:
+            uint64_t state = 0x853c49e6748fea9bULL, inc = 0xda3e39cb94b95bdbULL;
+
+        public:
+            Pcg32() = default;
+            Pcg32(const uint64_t& seed, const uint64_t& stream){
+                this->Seed(seed, stream);
+            }
+
+            void Seed(const uint64_t& seed, const uint64_t& stream){
+                this->state = 0;
+                this->inc = (stream << 1u) | 1u;
+                this->Next();
+                this->state += seed;
+                this->Next();
+            }
+
+            uint64_t GetState() const {
+                return this->state;
+            }
+
+            uint64_t GetIncrement() const {
+                return this->inc;
+            }
+
+            /**
+             * @brief Restore generator from saved state and increment
+             * @param _state
+             * @param _inc
+             */
+            void Restore(const uint64_t& _state, const uint64_t& _inc){
+                this->state = _state;
+                this->inc = _inc | 1u;
+            }
+
+            uint32_t Next(){
+                uint64_t old = this->state;
+                this->state = old * 6364136223846793005ULL + this->inc;
+                uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+                uint32_t rot = static_cast<uint32_t>(old >> 59u);
+                return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31u));
+            }
+
+            /**
+             * @brief Get uniform random number in [0, range) without modulo bias (Lemire)
+             * @param range
+             * @return uint32_t
+             */
+            uint32_t Bounded(const uint32_t& range){
+                uint64_t m = static_cast<uint64_t>(this->Next()) * range;
+                uint32_t low = static_cast<uint32_t>(m);
+                if(low < range){
+                    uint32_t threshold = (0u - range) % range;
+                    while(low < threshold){
+                        m = static_cast<uint64_t>(this->Next()) * range;
+                        low = static_cast<uint32_t>(m);
+                    }
+                }
+                return static_cast<uint32_t>(m >> 32);
+            }
+        };
+
+        /**
+         * @brief Position of the sampler inside the epoch, plain data so it can be copied per batch
+         * @ingroup LanternDataProcessing
+         */
+        struct SamplerCursor {
+            uint64_t epoch = 0;
+            uint32_t position = 0;
+            uint64_t rng_state = 0;
+            uint64_t rng_inc = 0;
+        };
+
+        /**
+         * @brief Full sampler state, saved with the model checkpoint to resume mid-epoch
+         * @ingroup LanternDataProcessing
+         */
+        struct SamplerState {
+            uint64_t seed = 0;
+            uint32_t total = 0;
+            uint32_t rank = 0, world_size = 1;
+            SamplerCursor cursor;
+            lantern::utility::Vector<uint32_t> class_taken;
+
+            static constexpr uint32_t magic = 0x3353534cu; // "LSS3"
+
+            /**
+             * @brief Serialize state into bytes
+             * @return lantern::utility::Vector<uint8_t>
+             */
+            lantern::utility::Vector<uint8_t> Serialize() const {
+                uint32_t total_class = this->class_taken.size();
+                uint32_t header[5] = {magic, this->total, total_class, this->rank, this->world_size};
+                uint64_t fields[5] = {this->seed, this->cursor.epoch, this->cursor.rng_state, this->cursor.rng_inc, this->cursor.position};
+                uint32_t size = static_cast<uint32_t>(sizeof(header) + sizeof(fields) + (size_t)total_class * sizeof(uint32_t));
+                lantern::utility::Vector<uint8_t> bytes(size);
+                bytes.explicitTotalItem(size);
+                uint8_t* out = bytes.getData();
+                std::memcpy(out, header, sizeof(header));
+                std::memcpy(out + sizeof(header), fields, sizeof(fields));
+                if(total_class > 0){
+                    std::memcpy(out + sizeof(header) + sizeof(fields), this->class_taken.getData(), (size_t)total_class * sizeof(uint32_t));
+                }
+                return bytes;
+            }
+
+            /**
+             * @brief Read state from bytes made by Serialize()
+             * @param data
+             * @param size
+             * @return SamplerState
+             */
+            static SamplerState Deserialize(const uint8_t* data, const size_t& size){
+                uint32_t header[5];
+                uint64_t fields[5];
+                if(size < sizeof(header) + sizeof(fields)){
+                    throw std::runtime_error("Error SamplerState, state buffer too small");
+                }
+                std::memcpy(header, data, sizeof(header));
+                std::memcpy(fields, data + sizeof(header), sizeof(fields));
+                if(header[0] != magic){
+                    throw std::runtime_error("Error SamplerState, invalid state buffer");
+                }
+                if(size != sizeof(header) + sizeof(fields) + (size_t)header[2] * sizeof(uint32_t)){
+                    throw std::runtime_error("Error SamplerState, state buffer size mismatch");
+                }
+                SamplerState state;
+                state.total = header[1];
+                state.rank = header[3];
+                state.world_size = header[4];
+                state.seed = fields[0];
+                state.cursor.epoch = fields[1];
+                state.cursor.rng_state = fields[2];
+                state.cursor.rng_inc = fields[3];
+                state.cursor.position = static_cast<uint32_t>(fields[4]);
+                const uint8_t* taken = data + sizeof(header) + sizeof(fields);
+                for(uint32_t c = 0; c < header[2]; c++){
+                    uint32_t value;
+                    std::memcpy(&value, taken + (size_t)c * sizeof(uint32_t), sizeof(uint32_t));
+                    state.class_taken.push_back(value);
+                }
+                return state;
+            }
+        };
+
+        /**
+         * @brief Seeded epoch sampler, every index is drawn exactly once per epoch.
+         *
+         * Each class own one segment of a reusable index array which is shuffled with Fisher-Yates
+         * at the start of every epoch, the permutation only depend on the seed and the epoch number.
+         * Draws are class-stratified, a batch ending at t draws first bring every class to the floor of
+         * t * class_size / total indices and give the rest to the classes furthest below that share, so no
+         * class goes over the ceil. Each drawn batch is shuffled so classes are mixed.
+         * A call usually cost O(batch + total class), plus amortized O(1) per index for the epoch shuffle,
+         * and no heap allocation happen after Setup().
+         *
+         * For data-parallel training every process create the sampler with the same seed and its own
+         * rank. All ranks build the same epoch permutation and rank r keep the shuffled positions
+         * r, r + world_size, ... of every class segment, so the shards keep the class balance. Every rank
+         * get ceil(class_size / world_size) indices of each class, a class that does not split evenly is
+         * padded by wrapping around its own shuffled segment like DistributedSampler, so all ranks run the
+         * same number of batches and no image or class is dropped, at the cost of a few repeated images.
+         * @ingroup LanternDataProcessing
+         */
+        class EpochSampler {
+        private:
+            lantern::utility::Vector<uint32_t> order;
+            lantern::utility::Vector<uint32_t> class_offsets;
+            lantern::utility::Vector<uint32_t> class_sizes;       // images of the class in the whole dataset
+            lantern::utility::Vector<uint32_t> class_shard_sizes; // images of the class given to this rank
+            lantern::utility::Vector<uint32_t> class_taken;
+            lantern::utility::Vector<uint32_t> candidates; // classes still below their ceil quota during a draw
+            lantern::utility::Vector<uint32_t> shuffled; // copy of one shuffled segment while its padded shard is gathered
+            uint64_t seed = 0, epoch = 0;
+            uint32_t total = 0, position = 0;
+            uint32_t rank = 0, world_size = 1;
+            Pcg32 rng;
+
+            /**
+             * @brief Reset every class segment and shuffle it for the given epoch
+             * @param _epoch
+             */
+            void BeginEpoch(const uint64_t& _epoch){
+                this->epoch = _epoch;
+                this->position = 0;
+                this->rng.Seed(this->seed, _epoch);
+                uint32_t* data = this->order.getData();
+                for(uint32_t i = 0; i < this->order.size(); i++){
+                    data[i] = i;
+                }
+                for(uint32_t c = 0; c < this->class_sizes.size(); c++){
+                    uint32_t* segment = data + this->class_offsets.getData()[c];
+                    uint32_t size = this->class_sizes.getData()[c];
+                    for(uint32_t i = size; i > 1; i--){
+                        std::swap(segment[i - 1], segment[this->rng.Bounded(i)]);
+                    }
+                    // keep the strided shard of this rank at the front of the segment, in place since rank + k * world_size >= k,
+                    // the padded tail wrap around to the segment start so it read from a copy
+                    if(this->world_size > 1){
+                        uint32_t shard_size = this->class_shard_sizes.getData()[c];
+                        if(size % this->world_size == 0){
+                            for(uint32_t k = 0; k < shard_size; k++){
+                                segment[k] = segment[this->rank + k * this->world_size];
+                            }
+                        }
+                        else{
+                            uint32_t* copy = this->shuffled.getData();
+                            std::memcpy(copy, segment, (size_t)size * sizeof(uint32_t));
+                            for(uint32_t k = 0; k < shard_size; k++){
+                                segment[k] = copy[(this->rank + (uint64_t)k * this->world_size) % size];
+                            }
+                        }
+                    }
+                    this->class_taken.getData()[c] = 0;
+                }
+            }
+
+            /**
+             * @brief Deficit of a class at the target position, scaled by total: its ideal share minus
+             * what it has given. The deficits of all classes sum to the draws left times total
+             * @param c
+             * @param target_position
+             * @return int64_t
+             */
+            int64_t Deficit(const uint32_t& c, const uint64_t& target_position) const {
+                return static_cast<int64_t>(target_position * this->class_shard_sizes.getData()[c]) -
+                       static_cast<int64_t>(static_cast<uint64_t>(this->class_taken.getData()[c]) * this->total);
+            }
+
+            /**
+             * @brief Draw count indices without crossing the epoch boundary
+             * @param out
+             * @param count
+             */
+            void Draw(uint32_t* out, const uint32_t& count){
+                const uint32_t* data = this->order.getData();
+                const uint32_t* offsets = this->class_offsets.getData();
+                const uint32_t* sizes = this->class_shard_sizes.getData();
+                uint32_t* taken = this->class_taken.getData();
+                uint32_t total_class = this->class_sizes.size();
+                uint64_t target_position = static_cast<uint64_t>(this->position) + count;
+                uint32_t emitted = 0;
+
+                uint64_t floor_draws = 0;
+                for(uint32_t c = 0; c < total_class; c++){
+                    int64_t deficit = this->Deficit(c, target_position);
+                    if(deficit > 0){
+                        floor_draws += static_cast<uint64_t>(deficit) / this->total;
+                    }
+                }
+
+                if(floor_draws <= count){
+                    // floor quota of every class, the rest is given to the classes with the largest deficit left,
+                    // each one is below its ceil quota and there are at least as many of them as draws left
+                    uint32_t* candidates = this->candidates.getData();
+                    uint32_t total_candidate = 0;
+                    for(uint32_t c = 0; c < total_class; c++){
+                        uint32_t target = static_cast<uint32_t>(target_position * sizes[c] / this->total);
+                        while(taken[c] < target){
+                            out[emitted++] = data[offsets[c] + taken[c]++];
+                        }
+                        if(this->Deficit(c, target_position) > 0){
+                            candidates[total_candidate++] = c;
+                        }
+                    }
+                    uint32_t rest = count - emitted;
+                    if(rest > 0){
+                        std::nth_element(candidates, candidates + rest - 1, candidates + total_candidate, [&](const uint32_t& a, const uint32_t& b){
+                            int64_t deficit_a = this->Deficit(a, target_position), deficit_b = this->Deficit(b, target_position);
+                            return deficit_a > deficit_b || (deficit_a == deficit_b && a < b);
+                        });
+                        // the chosen set is unique, sort it so the batch does not depend on the nth_element implementation
+                        std::sort(candidates, candidates + rest);
+                        for(uint32_t i = 0; i < rest; i++){
+                            uint32_t c = candidates[i];
+                            out[emitted++] = data[offsets[c] + taken[c]++];
+                        }
+                    }
+                }
+                else{
+                    // classes that got a remainder draw earlier can stay above their share while the others fall
+                    // below the floor, catching all of them up would overflow the batch so each draw go to the
+                    // class with the largest deficit, which is always positive while draws are left
+                    while(emitted < count){
+                        uint32_t best = 0;
+                        int64_t best_deficit = this->Deficit(0, target_position);
+                        for(uint32_t c = 1; c < total_class; c++){
+                            int64_t deficit = this->Deficit(c, target_position);
+                            if(deficit > best_deficit){
+                                best = c;
+                                best_deficit = deficit;
+                            }
+                        }
+                        out[emitted++] = data[offsets[best] + taken[best]++];
+                    }
+                }
+
+                for(uint32_t i = count; i > 1; i--){
+                    std::swap(out[i - 1], out[this->rng.Bounded(i)]);
+                }
+                this->position += count;
+            }
+
+        public:
+            EpochSampler() = default;
+
+            /**
+             * @brief Setup the sampler, index i belong to the class whose range contain i
+             * @param each_size total images of every class, in the same order as the images
+             * @param _seed must be the same on every rank
+             * @param _rank index of this process, in [0, world_size)
+             * @param _world_size total processes sharing the dataset
+             */
+            void Setup(lantern::utility::Vector<uint32_t>& each_size, const uint64_t& _seed, const uint32_t& _rank = 0, const uint32_t& _world_size = 1){
+                if(_world_size == 0 || _rank >= _world_size){
+                    throw std::runtime_error(std::format("Error EpochSampler, invalid rank {} for world size {}", _rank, _world_size));
+                }
+                this->class_offsets.clean();
+                this->class_sizes.clean();
+                this->class_shard_sizes.clean();
+                this->class_taken.clean();
+                this->rank = _rank;
+                this->world_size = _world_size;
+                this->total = 0;
+                uint32_t offset = 0, largest = 0;
+                for(auto size : each_size){
+                    if(size == 0){
+                        continue;
+                    }
+                    // ceil, the shard of a class with fewer images than ranks or a remainder is padded in BeginEpoch()
+                    uint32_t shard_size = size / _world_size + (size % _world_size != 0 ? 1 : 0);
+                    this->class_offsets.push_back(offset);
+                    this->class_sizes.push_back(size);
+                    this->class_shard_sizes.push_back(shard_size);
+                    this->class_taken.push_back(0);
+                    this->total += shard_size;
+                    offset += size;
+                    largest = std::max(largest, size);
+                }
+                if(this->total == 0){
+                    throw std::runtime_error("Error EpochSampler, cannot sample from empty dataset");
+                }
+                this->order = lantern::utility::Vector<uint32_t>(offset);
+                this->order.explicitTotalItem(offset);
+                this->candidates = lantern::utility::Vector<uint32_t>(this->class_sizes.size());
+                this->candidates.explicitTotalItem(this->class_sizes.size());
+                if(_world_size > 1){
+                    this->shuffled = lantern::utility::Vector<uint32_t>(largest);
+                    this->shuffled.explicitTotalItem(largest);
+                }
+                this->seed = _seed;
+                this->BeginEpoch(0);
+            }
+
+            /**
+             * @brief Get the next count indices, continue to the next epoch when needed
+             * @param out
+             * @param count
+             */
+            void Next(uint32_t* out, uint32_t count){
+                while(count > 0){
+                    uint32_t available = this->total - this->position;
+                    uint32_t n = count < available ? count : available;
+                    this->Draw(out, n);
+                    out += n;
+                    count -= n;
+                    if(this->position == this->total){
+                        this->BeginEpoch(this->epoch + 1);
+                    }
+                }
+            }
+
+            uint64_t GetEpoch() const {
+                return this->epoch;
+            }
+
+            uint32_t GetPosition() const {
+                return this->position;
+            }
+
+            uint32_t GetTotal() const {
+                return this->total;
+            }
+
+            uint64_t GetSeed() const {
+                return this->seed;
+            }
+
+            uint32_t GetTotalClass() const {
+                return this->class_sizes.size();
+            }
+
+            /**
+             * @brief List the indices drawn between two positions of the current epoch, without
+             * changing the sampler. Each class give the indices of its quota range, so the list can
+             * miss or add one index per class at the range ends, it is meant for prefetch hints.
+             * @param from epoch position, usually GetPosition()
+             * @param to epoch position, clamped to the epoch end
+             * @param out buffer with room for to - from + total class indices
+             * @return uint32_t total indices written
+             */
+            uint32_t Lookahead(const uint32_t& from, uint32_t to, uint32_t* out) const {
+                to = std::min(to, this->total);
+                if(from >= to){
+                    return 0;
+                }
+                const uint32_t* data = this->order.getData();
+                const uint32_t* offsets = this->class_offsets.getData();
+                const uint32_t* sizes = this->class_shard_sizes.getData();
+                uint32_t written = 0;
+                for(uint32_t c = 0; c < this->class_shard_sizes.size(); c++){
+                    uint32_t begin = static_cast<uint32_t>((uint64_t)from * sizes[c] / this->total);
+                    uint32_t end = static_cast<uint32_t>(((uint64_t)to * sizes[c] + this->total - 1) / this->total);
+                    for(uint32_t j = begin; j < end; j++){
+                        out[written++] = data[offsets[c] + j];
+                    }
+                }
+                return written;
+            }
+
+            uint32_t GetRank() const {
+                return this->rank;
+            }
+
+            uint32_t GetWorldSize() const {
+                return this->world_size;
+            }
+
+            /**
+             * @brief Get position inside the epoch without allocation, see CopyClassTaken()
+             * @return SamplerCursor
+             */
+            SamplerCursor GetCursor() const {
+                SamplerCursor cursor;
+                cursor.epoch = this->epoch;
+                cursor.position = this->position;
+                cursor.rng_state = this->rng.GetState();
+                cursor.rng_inc = this->rng.GetIncrement();
+                return cursor;
+            }
+
+            /**
+             * @brief Copy how many indices every class has given in this epoch
+             * @param out buffer with GetTotalClass() items
+             */
+            void CopyClassTaken(uint32_t* out) const {
+                if(this->class_taken.size() > 0){
+                    std::memcpy(out, this->class_taken.getData(), (size_t)this->class_taken.size() * sizeof(uint32_t));
+                }
+            }
+
+            /**
+             * @brief Get the full state of the sampler
+             * @return SamplerState
+             */
+            SamplerState GetState() const {
+                SamplerState state;
+                state.seed = this->seed;
+                state.total = this->total;
+                state.rank = this->rank;
+                state.world_size = this->world_size;
+                state.cursor = this->GetCursor();
+                for(uint32_t c = 0; c < this->class_taken.size(); c++){
+                    state.class_taken.push_back(this->class_taken.getData()[c]);
+                }
+                return state;
+            }
+
+            /**
+             * @brief Resume from saved state, the epoch permutation is rebuilt from seed and epoch
+             * so the sampler continue exactly at the saved position. Setup() must be called first
+             * with the same dataset.
+             * @param state
+             */
+            void SetState(const SamplerState& state){
+                if(state.rank != this->rank || state.world_size != this->world_size){
+                    throw std::runtime_error(std::format("Error EpochSampler, state was saved for rank {} of {} but sampler is rank {} of {}",
+                        state.rank, state.world_size, this->rank, this->world_size));
+                }
+                if(state.total != this->total || state.class_taken.size() != this->class_sizes.size()){
+                    throw std::runtime_error(std::format("Error EpochSampler, state was saved for {} images in {} classes but dataset has {} images in {} classes",
+                        state.total, state.class_taken.size(), this->total, this->class_sizes.size()));
+                }
+                uint32_t drawn = 0;
+                for(uint32_t c = 0; c < this->class_sizes.size(); c++){
+                    if(state.class_taken.getData()[c] > this->class_shard_sizes.getData()[c]){
+                        throw std::runtime_error("Error EpochSampler, state class cursor out of bound");
+                    }
+                    drawn += state.class_taken.getData()[c];
+                }
+                if(drawn != state.cursor.position || state.cursor.position >= this->total){
+                    throw std::runtime_error("Error EpochSampler, state position does not match class cursors");
+                }
+                this->seed = state.seed;
+                this->BeginEpoch(state.cursor.epoch);
+                std::memcpy(this->class_taken.getData(), state.class_taken.getData(), (size_t)this->class_taken.size() * sizeof(uint32_t));
+                this->position = state.cursor.position;
+                this->rng.Restore(state.cursor.rng_state, state.cursor.rng_inc);
+            }
+        };
     }
 
 }
\ No newline at end of file
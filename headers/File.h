@@ -1,24 +1,430 @@
 #pragma once
 #include "../pch.h"
 #include "Vector.h"
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <bit>
+#include <charconv>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LANTERN_CSV_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LANTERN_CSV_SSE2 1
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define LANTERN_CSV_NEON 1
+#endif
 
 /**
- * @brief Lantern CSV file wrapper
+ * @brief Read only memory mapping of a whole file, unmapped when destroyed
+ * @ingroup LanternFile
+ */
+class MappedFile
+{
+private:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&_file) noexcept
+    {
+        *this = std::move(_file);
+    }
+
+    MappedFile &operator=(MappedFile &&_file) noexcept
+    {
+        if (this != &_file)
+        {
+            this->Close();
+            std::swap(this->data, _file.data);
+            std::swap(this->size, _file.size);
+#if defined(_WIN32)
+            std::swap(this->file, _file.file);
+            std::swap(this->mapping, _file.mapping);
+#endif
+        }
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        this->Close();
+    }
+
+    /**
+     * @brief Map the whole file, the pages are only read from disk when touched
+     * @param _path
+     * @param _random_access hint the OS to not read ahead, for files read in random order
+     */
+    void Open(const std::filesystem::path &_path, const bool &_random_access = false)
+    {
+        this->Close();
+#if defined(_WIN32)
+        this->file = CreateFileW(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 _random_access ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (this->file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error(std::format("Error MappedFile, failed to open file \"{}\"", _path.string()));
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(this->file, &file_size))
+        {
+            this->Close();
+            throw std::runtime_error(std::format("Error MappedFile, failed to read size of file \"{}\"", _path.string()));
+        }
+        this->size = static_cast<size_t>(file_size.QuadPart);
+        if (this->size == 0)
+        {
+            return;
+        }
+        this->mapping = CreateFileMappingW(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void *view = this->mapping ? MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (view == nullptr)
+        {
+            this->Close();
+            throw std::runtime_error(std::format("Error MappedFile, failed to map file \"{}\"", _path.string()));
+        }
+        this->data = static_cast<const uint8_t *>(view);
+#else
+        int descriptor = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0)
+        {
+            throw std::runtime_error(std::format("Error MappedFile, failed to open file \"{}\"", _path.string()));
+        }
+        struct stat info;
+        if (::fstat(descriptor, &info) != 0)
+        {
+            ::close(descriptor);
+            throw std::runtime_error(std::format("Error MappedFile, failed to read size of file \"{}\"", _path.string()));
+        }
+        this->size = static_cast<size_t>(info.st_size);
+        if (this->size == 0)
+        {
+            ::close(descriptor);
+            return;
+        }
+        void *view = ::mmap(nullptr, this->size, PROT_READ, MAP_SHARED, descriptor, 0);
+        // the mapping keep the file alive, the descriptor is not needed anymore
+        ::close(descriptor);
+        if (view == MAP_FAILED)
+        {
+            this->size = 0;
+            throw std::runtime_error(std::format("Error MappedFile, failed to map file \"{}\"", _path.string()));
+        }
+        if (_random_access)
+        {
+            ::madvise(view, this->size, MADV_RANDOM);
+        }
+        this->data = static_cast<const uint8_t *>(view);
+#endif
+    }
+
+    void Close()
+    {
+#if defined(_WIN32)
+        if (this->data != nullptr)
+        {
+            UnmapViewOfFile(this->data);
+        }
+        if (this->mapping != nullptr)
+        {
+            CloseHandle(this->mapping);
+            this->mapping = nullptr;
+        }
+        if (this->file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(this->file);
+            this->file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (this->data != nullptr)
+        {
+            ::munmap(const_cast<uint8_t *>(this->data), this->size);
+        }
+#endif
+        this->data = nullptr;
+        this->size = 0;
+    }
+
+    const uint8_t *GetData() const
+    {
+        return this->data;
+    }
+
+    size_t GetSize() const
+    {
+        return this->size;
+    }
+};
+
+/**
+ * @brief Lantern CSV file wrapper. The file is memory mapped and never copied, every column keep the
+ * begin and length of its cells inside the mapping, so a cell cost 12 bytes and no allocation.
+ *
+ * The separators are found 64 bytes at a time, the comma, newline and quote of the block are turned into
+ * bit masks (AVX2, SSE2 or NEON when the compiler targets them, plain loops otherwise), the bytes inside
+ * quotes are the prefix XOR of the quote mask, so commas and newlines inside quoted fields are skipped
+ * without a branch per byte. Quoted fields follow RFC 4180, a quote inside is written twice.
  * @ingroup LanternFile
  */
 class CSVFile
 {
 private:
-    lantern::utility::Vector<lantern::utility::Vector<std::string>> data;
+    struct Column
+    {
+        lantern::utility::Vector<uint64_t> begins;
+        lantern::utility::Vector<uint32_t> lengths; // escaped_flag set when the quoted cell hold doubled quotes
+    };
+
+    static constexpr uint32_t escaped_flag = 0x80000000u;
+
+    MappedFile file;
+    const char *text = nullptr;
+    uint32_t total_rows = 0;
+    lantern::utility::Vector<Column> columns;
+    lantern::utility::Vector<lantern::utility::Vector<std::string>> table; // string copy of every cell, only built by GetDataPtr()
+
+    /**
+     * @brief Get bit mask of the bytes equal to the comma, newline and quote inside one 64 bytes block
+     * @param block
+     * @param commas
+     * @param newlines
+     * @param quotes
+     */
+    static void ClassifyBlock(const uint8_t *block, uint64_t &commas, uint64_t &newlines, uint64_t &quotes)
+    {
+#if defined(LANTERN_CSV_AVX2)
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+        auto mask = [&](const char &_value) -> uint64_t
+        {
+            __m256i value = _mm256_set1_epi8(_value);
+            uint32_t first = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, value)));
+            uint32_t second = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, value)));
+            return (uint64_t)first | ((uint64_t)second << 32);
+        };
+#elif defined(LANTERN_CSV_SSE2)
+        __m128i lanes[4];
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            lanes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i * 16));
+        }
+        auto mask = [&](const char &_value) -> uint64_t
+        {
+            __m128i value = _mm_set1_epi8(_value);
+            uint64_t bits = 0;
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                bits |= (uint64_t)static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lanes[i], value))) << (i * 16);
+            }
+            return bits;
+        };
+#elif defined(LANTERN_CSV_NEON)
+        uint8x16_t lanes[4] = {vld1q_u8(block), vld1q_u8(block + 16), vld1q_u8(block + 32), vld1q_u8(block + 48)};
+        auto mask = [&](const char &_value) -> uint64_t
+        {
+            // weight every lane by its bit, then add the lanes pairwise down to 8 bytes
+            const uint8x16_t weights = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+            uint8x16_t value = vdupq_n_u8(static_cast<uint8_t>(_value));
+            uint8x16_t sum0 = vpaddq_u8(vandq_u8(vceqq_u8(lanes[0], value), weights), vandq_u8(vceqq_u8(lanes[1], value), weights));
+            uint8x16_t sum1 = vpaddq_u8(vandq_u8(vceqq_u8(lanes[2], value), weights), vandq_u8(vceqq_u8(lanes[3], value), weights));
+            sum0 = vpaddq_u8(sum0, sum1);
+            sum0 = vpaddq_u8(sum0, sum0);
+            return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+        };
+#else
+        auto mask = [&](const char &_value) -> uint64_t
+        {
+            uint64_t bits = 0;
+            for (uint32_t i = 0; i < 64; i++)
+            {
+                bits |= (uint64_t)(block[i] == static_cast<uint8_t>(_value)) << i;
+            }
+            return bits;
+        };
+#endif
+        commas = mask(',');
+        newlines = mask('\n');
+        quotes = mask('"');
+    }
+
+    /**
+     * @brief Set every bit to the XOR of itself and all lower bits, the bytes between an opening and a closing quote
+     * @param _bits
+     * @return uint64_t
+     */
+    static uint64_t PrefixXor(uint64_t _bits)
+    {
+        _bits ^= _bits << 1;
+        _bits ^= _bits << 2;
+        _bits ^= _bits << 4;
+        _bits ^= _bits << 8;
+        _bits ^= _bits << 16;
+        _bits ^= _bits << 32;
+        return _bits;
+    }
+
+    /**
+     * @brief Store the cell that end before the separator
+     * @param _begin
+     * @param _end
+     * @param _column
+     */
+    void AddCell(uint64_t _begin, uint64_t _end, const uint32_t &_column)
+    {
+        uint32_t flag = 0;
+        if (_end - _begin >= 2 && this->text[_begin] == '"' && this->text[_end - 1] == '"')
+        {
+            _begin++;
+            _end--;
+            if (std::memchr(this->text + _begin, '"', _end - _begin) != nullptr)
+            {
+                flag = escaped_flag;
+            }
+        }
+        if (_end - _begin >= escaped_flag)
+        {
+            throw std::runtime_error("Error CSVFile, cell bigger than 2 GB");
+        }
+        Column &column = this->columns.getData()[_column];
+        column.begins.push_back(_begin);
+        column.lengths.push_back(static_cast<uint32_t>(_end - _begin) | flag);
+    }
 
     /**
-     * @brief Convert string into T type
+     * @brief Find every cell of the mapped file
+     * @param _path only used for error message
+     */
+    void Parse(const std::filesystem::path &_path)
+    {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(this->text);
+        uint64_t size = this->file.GetSize();
+        uint64_t cell_begin = 0;
+        if (size >= 3 && bytes[0] == 0xef && bytes[1] == 0xbb && bytes[2] == 0xbf)
+        {
+            cell_begin = 3; // UTF-8 byte order mark
+        }
+        uint32_t column = 0, total_cols = 0;
+        bool first_row = true;
+        static constexpr uint32_t sample_rows = 1024;
+
+        auto separator = [&](const uint64_t &_position, const bool &_newline)
+        {
+            uint64_t end = _position;
+            if (_newline && end > cell_begin && this->text[end - 1] == '\r')
+            {
+                end--;
+            }
+            if (_newline && column == 0 && end == cell_begin && (first_row || total_cols > 1))
+            {
+                // empty line, with a single column it is a row with an empty cell
+                cell_begin = _position + 1;
+                return;
+            }
+            if (first_row && column == this->columns.size())
+            {
+                this->columns.push_back(Column{});
+            }
+            if (column >= this->columns.size())
+            {
+                throw std::runtime_error(std::format("Error ReadCSVFile, the file \"{}\" has different columns sizes", _path.string()));
+            }
+            this->AddCell(cell_begin, end, column);
+            cell_begin = _position + 1;
+            if (!_newline)
+            {
+                column++;
+                return;
+            }
+            if (first_row)
+            {
+                first_row = false;
+                total_cols = column + 1;
+            }
+            else if (column + 1 != total_cols)
+            {
+                throw std::runtime_error(std::format("Error ReadCSVFile, the file \"{}\" has different columns sizes", _path.string()));
+            }
+            if (this->total_rows + 1 == sample_rows)
+            {
+                // reserve every column from the mean row length of the first rows, so the columns rarely grow
+                uint64_t rows_hint = size / std::max<uint64_t>((_position + 1) / sample_rows, 1);
+                rows_hint = std::min<uint64_t>(rows_hint + rows_hint / 8 + 16, std::numeric_limits<uint32_t>::max() / 2);
+                for (auto &item : this->columns)
+                {
+                    item.begins.resizeCapacity(static_cast<uint32_t>(rows_hint));
+                    item.lengths.resizeCapacity(static_cast<uint32_t>(rows_hint));
+                }
+            }
+            if (this->total_rows == std::numeric_limits<uint32_t>::max())
+            {
+                throw std::runtime_error(std::format("Error ReadCSVFile, the file \"{}\" has too many rows", _path.string()));
+            }
+            this->total_rows++;
+            column = 0;
+        };
+
+        uint64_t inside_quote = 0;
+        uint8_t tail[64];
+        for (uint64_t block = 0; block < size; block += 64)
+        {
+            const uint8_t *data = bytes + block;
+            if (size - block < 64)
+            {
+                std::memset(tail, 0, sizeof(tail));
+                std::memcpy(tail, data, size - block);
+                data = tail;
+            }
+            uint64_t commas, newlines, quotes;
+            ClassifyBlock(data, commas, newlines, quotes);
+            uint64_t quoted = PrefixXor(quotes) ^ inside_quote;
+            inside_quote = (uint64_t)0 - (quoted >> 63);
+            uint64_t separators = (commas | newlines) & ~quoted;
+            newlines &= ~quoted;
+            while (separators != 0)
+            {
+                uint32_t bit = static_cast<uint32_t>(std::countr_zero(separators));
+                separators &= separators - 1;
+                uint64_t position = block + bit;
+                if (position >= cell_begin)
+                {
+                    separator(position, (newlines >> bit) & 1);
+                }
+            }
+        }
+        if (cell_begin < size || column > 0)
+        {
+            // last line without newline
+            separator(size, true);
+        }
+    }
+
+    /**
+     * @brief Convert cell into T type
      * @tparam T
      * @param _str
      * @return T
      */
     template <typename T>
-    T ConvertFromString(const std::string &_str)
+    T ConvertFromString(const std::string_view &_str) const
     {
         if constexpr (std::is_arithmetic_v<T>)
         {
@@ -34,12 +440,12 @@ private:
         {
             if constexpr (std::is_same_v<T, std::string>)
             {
-                return _str;
+                return std::string(_str);
             }
             else
             {
                 T value{};
-                std::istringstream iss(_str);
+                std::istringstream iss{std::string(_str)};
                 iss >> value;
                 if (iss.fail() || !iss.eof())
                 {
@@ -50,24 +456,129 @@ private:
         }
     }
 
+    void CheckBound(const uint32_t &row, const uint32_t &col) const
+    {
+        if (col >= this->columns.size())
+        {
+            throw std::runtime_error(std::format("Error CSVFile, cannot access column index \"{}\" out of bound", col));
+        }
+        if (row >= this->total_rows)
+        {
+            throw std::runtime_error(std::format("Error CSVFile, cannot access row index \"{}\" out of bound", row));
+        }
+    }
+
+    /**
+     * @brief Get cell converted to T, doubled quotes of the cell are made single first
+     * @tparam T
+     * @param row
+     * @param col
+     * @return T
+     */
+    template <typename T>
+    T Cell(const uint32_t &row, const uint32_t &col) const
+    {
+        const Column &column = this->columns.getData()[col];
+        uint32_t length = column.lengths.getData()[row];
+        std::string_view cell(this->text + column.begins.getData()[row], length & ~escaped_flag);
+        if ((length & escaped_flag) == 0)
+        {
+            return this->ConvertFromString<T>(cell);
+        }
+        std::string unescaped;
+        unescaped.reserve(cell.size());
+        for (size_t i = 0; i < cell.size(); i++)
+        {
+            unescaped.push_back(cell[i]);
+            if (cell[i] == '"' && i + 1 < cell.size() && cell[i + 1] == '"')
+            {
+                i++;
+            }
+        }
+        return this->ConvertFromString<T>(unescaped);
+    }
+
+    /**
+     * @brief Copy every cell into table, kept until the next Open()
+     */
+    void BuildTable()
+    {
+        if (this->table.size() != this->total_rows)
+        {
+            this->table.clean();
+            for (uint32_t row = 0; row < this->total_rows; row++)
+            {
+                lantern::utility::Vector<std::string> cells(std::max<uint32_t>(this->columns.size(), 1));
+                for (uint32_t col = 0; col < this->columns.size(); col++)
+                {
+                    cells.push_back(this->Cell<std::string>(row, col));
+                }
+                this->table.push_back(std::move(cells));
+            }
+        }
+    }
+
 public:
     CSVFile() {}
+    CSVFile(const CSVFile &) = delete;
+    CSVFile &operator=(const CSVFile &) = delete;
+
     CSVFile(CSVFile &&_file) noexcept
     {
-        this->data.movePtrData(_file.data);
+        *this = std::move(_file);
     }
 
-    void operator=(CSVFile &&_file) noexcept
+    CSVFile &operator=(CSVFile &&_file) noexcept
     {
-        this->data.movePtrData(_file.data);
+        if (this != &_file)
+        {
+            this->file = std::move(_file.file);
+            this->text = _file.text;
+            this->total_rows = _file.total_rows;
+            this->columns = std::move(_file.columns);
+            this->table = std::move(_file.table);
+            _file.text = nullptr;
+            _file.total_rows = 0;
+        }
+        return *this;
     }
+
     /**
-     * @brief Get pointer to data inside CSV file
-     * @return lantern::utility::Vector<lantern::utility::Vector<std::string>>
+     * @brief Map the file and find every cell
+     * @param _path
      */
-    auto *GetDataPtr()
+    void Open(const std::filesystem::path &_path)
     {
-        return &this->data;
+        this->file.Open(_path);
+        this->text = reinterpret_cast<const char *>(this->file.GetData());
+        this->total_rows = 0;
+        this->columns = lantern::utility::Vector<Column>();
+        this->table.clean();
+        this->Parse(_path);
+    }
+
+    uint32_t Rows() const
+    {
+        return this->total_rows;
+    }
+
+    uint32_t Cols() const
+    {
+        return this->columns.size();
+    }
+
+    /**
+     * @brief Get cell inside the mapped file without copy, quotes around the cell are removed and
+     * doubled quotes inside are kept as written, use Get<std::string> to have them single
+     * @param row
+     * @param col
+     * @return std::string_view
+     */
+    std::string_view View(const uint32_t &row, const uint32_t &col) const
+    {
+        this->CheckBound(row, col);
+        const Column &column = this->columns.getData()[col];
+        return std::string_view(this->text + column.begins.getData()[row], column.lengths.getData()[row] & ~escaped_flag);
     }
 
     /**
@@ -78,17 +589,10 @@ public:
      * @return T
      */
     template <typename T>
-    T Get(const uint32_t &row, const uint32_t col)
+    T Get(const uint32_t &row, const uint32_t col) const
     {
-        if (col >= this->data.front().size())
-        {
-            throw std::runtime_error(std::format("Error CSVFile, cannot access column index \"{}\" out of bound", col));
-        }
-        if (row >= this->data.size())
-        {
-            throw std::runtime_error(std::format("Error CSVFile, cannot access row index \"{}\" out of bound", row));
-        }
-        return this->ConvertFromString<T>(this->data[row][col]);
+        this->CheckBound(row, col);
+        return this->Cell<T>(row, col);
     }
 
     /**
@@ -98,25 +602,17 @@ public:
      * @return lantern::utility::Vector<T>
      */
     template <typename T>
-    auto Col(const uint32_t &_index)
+    auto Col(const uint32_t &_index) const
     {
-
-        if (_index >= this->data.front().size())
+        if (_index >= this->columns.size())
         {
             throw std::runtime_error(std::format("Error CSVFile, cannot access column index \"{}\" out of bound", _index));
         }
-
-        lantern::utility::Vector<T> result(this->data.size());
-        result.explicitTotalItem(this->data.size());
-
-        std::transform(
-            this->data.begin(),
-            this->data.end(),
-            result.begin(),
-            [&](const lantern::utility::Vector<std::string> &row) -> T
-            {
-                return this->ConvertFromString<T>(row[_index]);
-            });
+        lantern::utility::Vector<T> result(std::max<uint32_t>(this->total_rows, 1));
+        for (uint32_t row = 0; row < this->total_rows; row++)
+        {
+            result.push_back(this->Cell<T>(row, _index));
+        }
         return result;
     }
 
@@ -127,36 +623,40 @@ public:
      * @return lantern::utility::Vector<T>
      */
     template <typename T>
-    auto Row(const uint32_t &_index)
+    auto Row(const uint32_t &_index) const
     {
-
-        if (_index >= this->data.size())
+        if (_index >= this->total_rows)
         {
             throw std::runtime_error(std::format("Error CSVFile, cannot access row index \"{}\" out of bound", _index));
         }
-
-        auto &data_ = this->data[_index];
-        uint32_t allocated_size = data_.size();
-        lantern::utility::Vector<T> result(allocated_size);
-        result.explicitTotalItem(allocated_size);
-        std::transform(
-            data_.begin(),
-            data_.end(),
-            result.begin(),
-            [&](const std::string_view &_str) -> T
-            {
-                return this->ConvertFromString<T>(_str);
-            });
+        lantern::utility::Vector<T> result(std::max<uint32_t>(this->columns.size(), 1));
+        for (uint32_t col = 0; col < this->columns.size(); col++)
+        {
+            result.push_back(this->Cell<T>(_index, col));
+        }
         return result;
     }
 
+    /**
+     * @brief Get pointer to every cell as string, the table is copied from the mapped file on first call
+     * @return lantern::utility::Vector<lantern::utility::Vector<std::string>>
+     */
+    [[deprecated("copy every cell of the file, use Get, View, Row or Col")]]
+    auto *GetDataPtr()
+    {
+        this->BuildTable();
+        return &this->table;
+    }
+
+    [[deprecated("copy every cell of the file, use Row or View")]]
     auto GetPtrRow(const uint32_t &_index)
     {
-        if (_index >= this->data.size())
+        if (_index >= this->total_rows)
         {
             throw std::runtime_error(std::format("Error CSVFile, cannot access row index \"{}\" out of bound", _index));
         }
-        return &this->data[_index];
+        this->BuildTable();
+        return &this->table[_index];
     }
 };
 
@@ -169,58 +669,26 @@ public:
 [[nodiscard]]
 inline CSVFile ReadCSVFile(const std::filesystem::path &_path)
 {
-
-    CSVFile result;
-    auto &data = (*result.GetDataPtr());
-
     if (!std::filesystem::exists(_path))
     {
         throw std::runtime_error(std::format("Error CSVReader, cannot access file path \"{}\" looks like deleted or moved", _path.string()));
     }
-
-    // first check extension
-    if (std::filesystem::is_regular_file(_path))
+    if (!std::filesystem::is_regular_file(_path))
     {
-        std::string ext = _path.extension().string(), col_data, line;
-        std::transform(ext.begin(), ext.end(), ext.begin(), [](const char &d)
-                       { return std::tolower(d); });
-        if (ext.compare(".csv") == 0)
-        {
-            std::ifstream file(_path);
-            if (!file.is_open())
-            {
-                throw std::runtime_error(std::format("Error CSVReader, failed to open file \"{}\"", ext));
-            }
-
-            while (std::getline(file, line))
-            {
-                data.push_back(lantern::utility::Vector<std::string>(20));
-                std::stringstream ss(line);
-
-                while (std::getline(ss, col_data, ','))
-                {
-                    data.back().push_back(col_data);
-                }
-
-                if (!data.empty())
-                {
-                    if (data.front().size() != data.back().size())
-                    {
-                        throw std::runtime_error(std::format("Error ReadCSVFile, the file \"{}\" has different columns sizes", _path.string()));
-                    }
-                }
-            }
-        }
-        else
-        {
-            throw std::runtime_error(std::format("Error CSVReader, the file extension \"{}\" is not json file", ext));
-        }
+        throw std::runtime_error(std::format("Error CSVReader, the path \"{}\" is not file path", _path.string()));
     }
-    else
+
+    // first check extension
+    std::string ext = _path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](const char &d)
+                   { return std::tolower(d); });
+    if (ext.compare(".csv") != 0)
     {
-        throw std::runtime_error(std::format("Error CSVReader, the path \"{}\" is not file path", _path.string()));
+        throw std::runtime_error(std::format("Error CSVReader, the file extension \"{}\" is not json file", ext));
     }
 
+    CSVFile result;
+    result.Open(_path);
     return result;
 }
 /**
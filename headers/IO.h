@@ -0,0 +1,226 @@
+#pragma once
+#include "../pch.h"
+#include "Vector.h"
+#if defined(LANTERN_USE_IO_URING) && defined(__linux__) && __has_include(<liburing.h>)
+#include <liburing.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LANTERN_HAS_IO_URING 1
+#endif
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace lantern {
+
+    namespace utility {
+
+        /**
+         * @brief Ask the OS to start reading the whole file into page cache, return at once.
+         * Only a hint, it does nothing where posix_fadvise is not available
+         * @param path
+         * @ingroup LanternFile
+         */
+        inline void AdviseWillNeed(const std::string &path) {
+#if defined(__linux__)
+            int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (descriptor >= 0) {
+                ::posix_fadvise(descriptor, 0, 0, POSIX_FADV_WILLNEED);
+                ::close(descriptor);
+            }
+#else
+            (void)path;
+#endif
+        }
+
+        /**
+         * @brief Read whole files of one batch into a single buffer, owned by one I/O thread.
+         *
+         * With io_uring (build with LANTERN_USE_IO_URING and liburing) every read of the batch
+         * is submitted at once so the disk see the whole batch as queue depth, otherwise the
+         * files are read one after another and the parallelism come from several I/O threads.
+         * @ingroup LanternFile
+         */
+        class FileBatchReader {
+        private:
+#if defined(LANTERN_HAS_IO_URING)
+            struct io_uring ring;
+            bool ring_ready = false;
+            uint32_t ring_depth = 0;
+            lantern::utility::Vector<int> descriptors;
+            lantern::utility::Vector<uint32_t> done, again;
+
+            /**
+             * @brief Read with io_uring, short reads are submitted again for the rest of the file
+             */
+            void ReadUring(const std::string *const *paths, const uint32_t &count, uint8_t *buffer, const uint64_t *offsets, uint32_t *sizes) {
+                this->done.clean();
+                for (uint32_t i = 0; i < count; i++) {
+                    this->done.push_back(0);
+                }
+                auto &done = this->done;
+                auto &again = this->again;
+                uint32_t pending = 0, next = 0;
+                auto submit = [&](const uint32_t &i) {
+                    struct io_uring_sqe *sqe = io_uring_get_sqe(&this->ring);
+                    io_uring_prep_read(sqe, this->descriptors.getData()[i], buffer + offsets[i] + done.getData()[i],
+                                       sizes[i] - done.getData()[i], done.getData()[i]);
+                    io_uring_sqe_set_data64(sqe, i);
+                    pending++;
+                };
+                while (next < count || pending > 0) {
+                    // keep the submission queue full with the files not started yet
+                    while (next < count && pending < this->ring_depth) {
+                        if (this->descriptors.getData()[next] >= 0 && sizes[next] > 0) {
+                            submit(next);
+                        }
+                        next++;
+                    }
+                    if (pending == 0) {
+                        continue;
+                    }
+                    io_uring_submit_and_wait(&this->ring, 1);
+                    struct io_uring_cqe *cqe;
+                    unsigned head, seen = 0;
+                    again.clean();
+                    io_uring_for_each_cqe(&this->ring, head, cqe) {
+                        uint32_t i = static_cast<uint32_t>(io_uring_cqe_get_data64(cqe));
+                        seen++;
+                        pending--;
+                        if (cqe->res <= 0) {
+                            sizes[i] = 0;
+                            continue;
+                        }
+                        done.getData()[i] += static_cast<uint32_t>(cqe->res);
+                        if (done.getData()[i] < sizes[i]) {
+                            again.push_back(i);
+                        }
+                    }
+                    io_uring_cq_advance(&this->ring, seen);
+                    for (auto i : again) {
+                        submit(i);
+                    }
+                }
+            }
+#endif
+
+            /**
+             * @brief The read buffer is indexed with 32 bits, a batch of files bigger than 4 GB can not fit in it
+             */
+            static void CheckBatchBytes(const uint64_t &total) {
+                if (total > std::numeric_limits<uint32_t>::max()) {
+                    throw std::runtime_error(std::format("Error FileBatchReader, files of one batch take {} bytes, more than 4 GB", total));
+                }
+            }
+
+        public:
+            /**
+             * @brief Create the reader
+             * @param _queue_depth total reads in flight with io_uring, ignored by the fallback
+             */
+            explicit FileBatchReader(const uint32_t &_queue_depth = 32) {
+#if defined(LANTERN_HAS_IO_URING)
+                this->ring_depth = std::max<uint32_t>(_queue_depth, 1);
+                this->ring_ready = io_uring_queue_init(this->ring_depth, &this->ring, 0) == 0;
+#else
+                (void)_queue_depth;
+#endif
+            }
+
+            FileBatchReader(const FileBatchReader &) = delete;
+            FileBatchReader &operator=(const FileBatchReader &) = delete;
+
+            ~FileBatchReader() {
+#if defined(LANTERN_HAS_IO_URING)
+                if (this->ring_ready) {
+                    io_uring_queue_exit(&this->ring);
+                }
+#endif
+            }
+
+            /**
+             * @brief Check if reads go through io_uring
+             * @return bool
+             */
+            bool IsAsync() const {
+#if defined(LANTERN_HAS_IO_URING)
+                return this->ring_ready;
+#else
+                return false;
+#endif
+            }
+
+            /**
+             * @brief Read every file into the buffer back to back
+             * @param paths
+             * @param count
+             * @param buffer grown when too small
+             * @param offsets offset of every file inside buffer
+             * @param sizes size of every file, 0 when the file cannot be read
+             */
+            void Read(const std::string *const *paths, const uint32_t &count, lantern::utility::Vector<uint8_t> &buffer, uint64_t *offsets, uint32_t *sizes) {
+#if defined(LANTERN_HAS_IO_URING)
+                if (this->ring_ready) {
+                    this->descriptors.clean();
+                    uint64_t total = 0;
+                    for (uint32_t i = 0; i < count; i++) {
+                        int descriptor = ::open(paths[i]->c_str(), O_RDONLY | O_CLOEXEC);
+                        struct stat info;
+                        sizes[i] = 0;
+                        if (descriptor >= 0 && ::fstat(descriptor, &info) == 0 && info.st_size > 0 &&
+                            static_cast<uint64_t>(info.st_size) <= static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+                            sizes[i] = static_cast<uint32_t>(info.st_size);
+                        }
+                        offsets[i] = total;
+                        total += sizes[i];
+                        this->descriptors.push_back(descriptor);
+                    }
+                    if (total > std::numeric_limits<uint32_t>::max()) {
+                        for (auto descriptor : this->descriptors) {
+                            if (descriptor >= 0) {
+                                ::close(descriptor);
+                            }
+                        }
+                    }
+                    CheckBatchBytes(total);
+                    if (buffer.getCapacity() < total) {
+                        buffer = lantern::utility::Vector<uint8_t>(static_cast<uint32_t>(total));
+                    }
+                    this->ReadUring(paths, count, buffer.getData(), offsets, sizes);
+                    for (auto descriptor : this->descriptors) {
+                        if (descriptor >= 0) {
+                            ::close(descriptor);
+                        }
+                    }
+                    return;
+                }
+#endif
+                uint64_t total = 0;
+                for (uint32_t i = 0; i < count; i++) {
+                    std::error_code error;
+                    uint64_t size = std::filesystem::file_size(*paths[i], error);
+                    sizes[i] = (error || size > static_cast<uint64_t>(std::numeric_limits<int>::max())) ? 0 : static_cast<uint32_t>(size);
+                    offsets[i] = total;
+                    total += sizes[i];
+                }
+                CheckBatchBytes(total);
+                if (buffer.getCapacity() < total) {
+                    buffer = lantern::utility::Vector<uint8_t>(static_cast<uint32_t>(total));
+                }
+                for (uint32_t i = 0; i < count; i++) {
+                    if (sizes[i] == 0) {
+                        continue;
+                    }
+                    std::ifstream file(*paths[i], std::ios::binary);
+                    if (!file.read(reinterpret_cast<char *>(buffer.getData() + offsets[i]), sizes[i])) {
+                        sizes[i] = 0;
+                    }
+                }
+            }
+        };
+
+    }
+
+}
@@ -0,0 +1,252 @@
+#pragma once
+#include "../pch.h"
+#include "Ring.h"
+#include "Vector.h"
+
+/**
+ * @brief Give a ring position back, when the slot is shared by several leases
+ * the position is released only by the last holder
+ * @param ring
+ * @param refs
+ * @param pos
+ * @ingroup LanternContainer
+ */
+inline void ReleaseRingPosition(lantern::utility::SlotRing *ring, std::atomic<uint32_t> *refs, const uint64_t &pos)
+{
+    if (refs == nullptr || refs->fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        ring->ReleaseRead(pos);
+    }
+}
+
+/**
+ * @brief RAII handle of one image inside the loader ring, the slot is given back
+ * to the decode workers when the lease destroyed or released, so the image can be
+ * read in place without copy. Holding a lease for long time stall the workers once
+ * they wrap around to this slot.
+ */
+class ImageLease
+{
+private:
+    lantern::utility::SlotRing *ring = nullptr;
+    std::atomic<uint32_t> *refs = nullptr;
+    uint64_t pos = 0;
+    uint32_t slot = 0;
+    uint8_t *image = nullptr;
+    const uint32_t *label = nullptr;
+    const lantern::utility::Vector<std::string> *class_names = nullptr;
+
+public:
+    ImageLease() = default;
+    ImageLease(lantern::utility::SlotRing *_ring, std::atomic<uint32_t> *_refs, const uint64_t &_pos, uint8_t *_image, const uint32_t *_label,
+               const lantern::utility::Vector<std::string> *_class_names)
+        : ring(_ring), refs(_refs), pos(_pos), slot(_ring->SlotOf(_pos)), image(_image), label(_label), class_names(_class_names) {}
+
+    ImageLease(const ImageLease &) = delete;
+    ImageLease &operator=(const ImageLease &) = delete;
+
+    ImageLease(ImageLease &&_lease) noexcept
+        : ring(_lease.ring), refs(_lease.refs), pos(_lease.pos), slot(_lease.slot), image(_lease.image), label(_lease.label),
+          class_names(_lease.class_names)
+    {
+        _lease.ring = nullptr;
+    }
+
+    ImageLease &operator=(ImageLease &&_lease) noexcept
+    {
+        if (this != &_lease)
+        {
+            this->Release();
+            this->ring = _lease.ring;
+            this->refs = _lease.refs;
+            this->pos = _lease.pos;
+            this->slot = _lease.slot;
+            this->image = _lease.image;
+            this->label = _lease.label;
+            this->class_names = _lease.class_names;
+            _lease.ring = nullptr;
+        }
+        return *this;
+    }
+
+    ~ImageLease()
+    {
+        this->Release();
+    }
+
+    /**
+     * @brief Give the slot back to the ring, the data pointer is invalid after this
+     */
+    void Release()
+    {
+        if (this->ring != nullptr)
+        {
+            ReleaseRingPosition(this->ring, this->refs, this->pos);
+            this->ring = nullptr;
+        }
+    }
+
+    explicit operator bool() const
+    {
+        return this->ring != nullptr;
+    }
+
+    uint8_t *GetData() const
+    {
+        return this->image;
+    }
+
+    /**
+     * @brief Get class name of the image, looked up from its class id
+     * @return const std::string&
+     */
+    const std::string &GetLabel() const
+    {
+        return this->class_names->getData()[*this->label];
+    }
+
+    uint32_t GetLabelId() const
+    {
+        return *this->label;
+    }
+
+    uint32_t GetSlot() const
+    {
+        return this->slot;
+    }
+};
+
+/**
+ * @brief RAII handle of one whole batch inside the loader ring. The images are stored
+ * contiguous as N x H x W x C and the buffer is aligned to cache line, the slot is given
+ * back to the decode workers when the lease destroyed or released.
+ */
+class BatchLease
+{
+private:
+    lantern::utility::SlotRing *ring = nullptr;
+    uint64_t pos = 0;
+    uint32_t slot = 0, total_images = 0;
+    size_t image_size = 0;
+    uint8_t *images = nullptr;
+    const uint32_t *labels = nullptr;
+    const lantern::utility::Vector<std::string> *class_names = nullptr;
+
+public:
+    BatchLease() = default;
+    BatchLease(lantern::utility::SlotRing *_ring, const uint64_t &_pos, uint8_t *_images, const uint32_t *_labels,
+               const lantern::utility::Vector<std::string> *_class_names, const uint32_t &_total_images, const size_t &_image_size)
+        : ring(_ring), pos(_pos), slot(_ring->SlotOf(_pos)), total_images(_total_images), image_size(_image_size), images(_images), labels(_labels),
+          class_names(_class_names) {}
+
+    BatchLease(const BatchLease &) = delete;
+    BatchLease &operator=(const BatchLease &) = delete;
+
+    BatchLease(BatchLease &&_lease) noexcept
+        : ring(_lease.ring), pos(_lease.pos), slot(_lease.slot), total_images(_lease.total_images), image_size(_lease.image_size), images(_lease.images), labels(_lease.labels),
+          class_names(_lease.class_names)
+    {
+        _lease.ring = nullptr;
+    }
+
+    BatchLease &operator=(BatchLease &&_lease) noexcept
+    {
+        if (this != &_lease)
+        {
+            this->Release();
+            this->ring = _lease.ring;
+            this->pos = _lease.pos;
+            this->slot = _lease.slot;
+            this->total_images = _lease.total_images;
+            this->image_size = _lease.image_size;
+            this->images = _lease.images;
+            this->labels = _lease.labels;
+            this->class_names = _lease.class_names;
+            _lease.ring = nullptr;
+        }
+        return *this;
+    }
+
+    ~BatchLease()
+    {
+        this->Release();
+    }
+
+    /**
+     * @brief Give the batch back to the ring, the data pointer is invalid after this
+     */
+    void Release()
+    {
+        if (this->ring != nullptr)
+        {
+            this->ring->ReleaseRead(this->pos);
+            this->ring = nullptr;
+        }
+    }
+
+    explicit operator bool() const
+    {
+        return this->ring != nullptr;
+    }
+
+    /**
+     * @brief Get pointer to the first image of the batch
+     * @return uint8_t*
+     */
+    uint8_t *GetData() const
+    {
+        return this->images;
+    }
+
+    /**
+     * @brief Get pointer to image at index inside the batch
+     * @param _index
+     * @return uint8_t*
+     */
+    uint8_t *GetImage(const uint32_t &_index) const
+    {
+        if (_index >= this->total_images)
+        {
+            throw std::runtime_error(std::format("Error BatchLease, cannot access image index \"{}\" out of bound", _index));
+        }
+        return this->images + (size_t)_index * this->image_size;
+    }
+
+    /**
+     * @brief Get class id array of the batch, one class id for each image
+     * @return const uint32_t*
+     */
+    const uint32_t *GetLabelIds() const
+    {
+        return this->labels;
+    }
+
+    /**
+     * @brief Get class name of image at index inside the batch
+     * @param _index
+     * @return const std::string&
+     */
+    const std::string &GetLabel(const uint32_t &_index) const
+    {
+        if (_index >= this->total_images)
+        {
+            throw std::runtime_error(std::format("Error BatchLease, cannot access label index \"{}\" out of bound", _index));
+        }
+        return this->class_names->getData()[this->labels[_index]];
+    }
+
+    uint32_t Size() const
+    {
+        return this->total_images;
+    }
+
+    size_t GetImageSize() const
+    {
+        return this->image_size;
+    }
+
+    uint32_t GetSlot() const
+    {
+        return this->slot;
+    }
+};
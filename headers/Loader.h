@@ -3,163 +3,1845 @@
 #include "Vector.h"
 #include "DataProcessing.h"
 #include "File.h"
+#include "Ring.h"
+#include "Lease.h"
+#include "Cache.h"
+#include "Shard.h"
+#include "IO.h"
+#include "Convert.h"
+#include "Augment.h"
+#include "PathPool.h"
+#include "Scan.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include "stb_image_resize2.h"
 
-template <uint32_t TOTAL_IMAGES, uint32_t IMG_WIDTH, uint32_t IMG_HEIGHT, bool IsColor>
-class LanternImageLoader
+/**
+ * @brief Runtime configuration of LanternDynamicImageLoader
+ */
+struct LanternImageLoaderConfig
 {
-private:
-    std::mutex mutex;
-    std::condition_variable producer, consumer;
+    uint32_t queue_depth = 2; // total batch slots inside the ring, the prefetch depth
+    uint32_t batch_size = 1;  // total images inside one batch slot, also the sampler batch size
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 3;    // 1 grayscale, 2 grayscale alpha, 3 RGB, 4 RGBA
+    uint64_t seed = std::random_device{}(); // sampler seed, set it to reproduce the image order
+    uint32_t rank = 0;        // index of this process in distributed training
+    uint32_t world_size = 1;  // total processes, each one read and decode only its own shard
+    std::string cache_directory; // keep resized images on disk here, empty to disable
+    bool in_memory = false;   // decode the whole folder dataset once into RAM and serve from there
+    uint64_t encoded_cache_budget = 0; // bytes of encoded image files kept in RAM and decoded from there, 0 to disable
+    uint32_t io_workers = 0;      // threads reading files ahead of the decode workers, 0 to let decode workers read
+    uint32_t io_queue_depth = 32; // reads in flight per I/O thread when io_uring is used
+    uint32_t prefetch_lookahead = 0; // images ahead of the sampler hinted to the OS page cache, 0 to disable
+    lantern::data::Normalization normalization; // applied by GetAsAF, default only scale to [0, 1]
+    lantern::data::PixelType output_type = lantern::data::PixelType::Float32; // element type of GetAsAF and GetBatchAsAF
+    lantern::data::TensorLayout output_layout = lantern::data::TensorLayout::CWH; // layout of GetAsAF and GetBatchAsAF
+    lantern::data::Augmentation augmentation; // random crop, flip and jitter applied by the workers, default disabled
+    lantern::utility::PathLayout path_layout = lantern::utility::PathLayout::Plain; // how the image paths of folder datasets are stored
+};
+
+/**
+ * @brief Every image of a dataset decoded and resized once, stored back to back
+ */
+struct DecodedArena
+{
+    std::unique_ptr<uint8_t[]> pixels; // total_images x image_size, can be bigger than 4 GB
+    lantern::utility::Vector<uint8_t> valid;
+    uint32_t width = 0, height = 0, channels = 0, total_images = 0;
+};
+
+/**
+ * @brief Encoded image files of a dataset read once into RAM, up to a memory budget
+ */
+struct EncodedArena
+{
+    static constexpr uint64_t not_pinned = ~0ULL;
+    std::unique_ptr<uint8_t[]> bytes;
+    lantern::utility::Vector<uint64_t> offsets; // offset of every image inside bytes, not_pinned when kept on disk
+    lantern::utility::Vector<uint32_t> sizes;
+    uint64_t budget = 0, used = 0;
+    uint32_t total_images = 0, total_pinned = 0;
+};
+
+/**
+ * @brief Ring slots memory of a dataset, queue depth x batch stride bytes, can be bigger than 4 GB
+ */
+struct SlotCache
+{
+    std::unique_ptr<uint8_t[]> bytes;
+    size_t capacity = 0;
+};
+
+/**
+ * @brief Image loader configured at runtime, queue depth, batch size and output shape
+ * can be changed without recompile. LanternImageLoader is the compile time form on top of it.
+ */
+class LanternDynamicImageLoader
+{
+protected:
+    lantern::utility::SlotRing ring;
+    LanternImageLoaderConfig config;
+    size_t image_size = 0;
+    size_t output_size = 0; // bytes of one image converted to the output format
+    lantern::data::ImageConverter converter = nullptr;
 
-    lantern::utility::Vector<uint32_t> each_class_sizes;
-    std::unordered_map<std::string, lantern::utility::Vector<std::string>> image_paths;
-    std::unordered_map<std::string, lantern::utility::Vector<uint8_t>> image_cache;
-    std::unordered_map<std::string, std::array<std::string,TOTAL_IMAGES>> label_cache;
+    std::unordered_map<std::string, lantern::utility::Vector<uint32_t>> each_class_sizes;
+    std::unordered_map<std::string, lantern::utility::PathPool> image_paths;
+    std::unordered_map<std::string, SlotCache> image_cache;
+    std::unordered_map<std::string, lantern::utility::Vector<uint32_t>> label_cache;
+    // class names interned once at scan time, the ring and the leases only carry the dense class id
+    std::unordered_map<std::string, lantern::utility::Vector<std::string>> class_names;
+    std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> class_name_ids;
+    std::unordered_map<std::string, lantern::utility::Vector<uint32_t>> image_class_ids; // same order as image_paths or shard_records
+    // datasets loaded from packed shards, the records are grouped by class like image_paths
+    std::unordered_map<std::string, lantern::utility::Vector<ShardFile>> image_shards;
+    std::unordered_map<std::string, lantern::utility::Vector<ShardRecord>> shard_records;
+    std::unordered_map<std::string, DecodedArena> decoded_arenas;
+    std::unordered_map<std::string, EncodedArena> encoded_arenas;
+    ImageDiskCache disk_cache;
     std::unordered_map<std::string, CSVFile> labels;
     std::string active_dataset;
-    size_t allocation = TOTAL_IMAGES * IMG_WIDTH * IMG_HEIGHT * (IsColor ? 3 : 1);
-    std::thread thread_loader;
+    lantern::utility::Vector<std::thread> thread_loaders;
     std::atomic<bool> stop_thread = false;
 
-    uint32_t head = 0, tail = 0, count = 0;
+    // resolved once in Run() so the hot path does not hash the dataset name
+    uint8_t *active_image_cache = nullptr;
+    uint32_t *active_label_cache = nullptr;
+    const uint32_t *active_class_ids = nullptr;
+    const lantern::utility::Vector<std::string> *active_class_names = nullptr;
+    const lantern::utility::PathPool *active_image_paths = nullptr;
+    const ShardFile *active_shards = nullptr;
+    const ShardRecord *active_records = nullptr;
+    const DecodedArena *active_arena = nullptr;
+    const EncodedArena *active_encoded = nullptr;
+    uint32_t active_total_images = 0;
+
+    // I/O stage, the I/O threads reserve the slot and read the files of its batch, then hand the
+    // slot position to the decode workers through io_ring
+    lantern::utility::SlotRing io_ring;
+    std::unique_ptr<uint64_t[]> io_positions;
+    std::unique_ptr<lantern::utility::Vector<uint8_t>[]> slot_read_buffers;
+    lantern::utility::Vector<uint64_t> slot_read_offsets;
+    lantern::utility::Vector<uint32_t> slot_read_sizes;
+    lantern::utility::Vector<uint32_t> slot_indices;
+    bool io_stage = false;
+
+    // lookahead prefetch, the sampler window already hinted, guarded by sampler_mutex
+    bool prefetch_active = false;
+    uint64_t prefetch_epoch = 0;
+    uint32_t prefetch_until = 0;
+
+    // every image get its own augmentation seed from its sampler draw
+    bool augment_active = false;
+
+    // host image of GetAsAF and pinned host batch of GetBatchAsAF in the output format, reused across calls
+    struct PinnedFree
+    {
+        void operator()(uint8_t *_data) const
+        {
+            af::freePinned(_data);
+        }
+    };
+    std::mutex staging_mutex;
+    std::unique_ptr<uint8_t[]> af_staging;
+    size_t af_staging_capacity = 0;
+    std::unique_ptr<uint8_t, PinnedFree> af_batch_staging;
+    size_t af_batch_capacity = 0;
+
+    // every ring slot hold one whole batch, stored contiguous and aligned to cache line
+    size_t batch_stride = 0;
+
+    // consumer cursor used by Get() to hand out single image from batch slot
+    std::mutex consumer_mutex;
+    std::mutex cursor_mutex; // held by the consumer waiting for the next slot, always taken before consumer_mutex
+    std::unique_ptr<std::atomic<uint32_t>[]> slot_refs;
+    uint64_t cursor_pos = 0;
+    uint32_t cursor_offset = 0;
+    bool has_cursor = false;
+
+    // sampler shared by every worker, each worker claim the next indices from the same epoch
+    std::mutex sampler_mutex;
+    lantern::data::EpochSampler sampler;
+
+    // sampler position after the draw of every slot, copied to consumed_* when the consumer take the slot
+    std::unique_ptr<lantern::data::SamplerCursor[]> slot_cursors;
+    lantern::utility::Vector<uint32_t> slot_class_taken;
+    lantern::data::SamplerCursor consumed_cursor;
+    lantern::utility::Vector<uint32_t> consumed_class_taken;
+    std::optional<lantern::data::SamplerState> pending_sampler_state;
+
+    /**
+     * @brief Get stb resize layout for total channels
+     * @param _channels
+     * @return stbir_pixel_layout
+     */
+    static stbir_pixel_layout PixelLayoutOf(const uint32_t &_channels)
+    {
+        switch (_channels)
+        {
+        case 1:
+            return STBIR_1CHANNEL;
+        case 2:
+            return STBIR_2CHANNEL;
+        case 4:
+            return STBIR_RGBA;
+        default:
+            return STBIR_RGB;
+        }
+    }
+
+    /**
+     * @brief Resize the random crop of the sample from source into destination, the crop
+     * is read in place through the row stride
+     * @param source HWC image with the configured channels
+     * @param width source width
+     * @param height source height
+     * @param destination
+     * @param sample_seed
+     * @return bool
+     */
+    bool CropResize(const uint8_t *source, const uint32_t &width, const uint32_t &height, uint8_t *destination, const uint64_t &sample_seed)
+    {
+        lantern::data::CropRect rect = lantern::data::DrawCrop(this->config.augmentation, sample_seed, width, height);
+        const uint8_t *origin = source + ((size_t)rect.y * width + rect.x) * this->config.channels;
+        return stbir_resize_uint8_linear(
+                   origin,
+                   rect.width, rect.height, static_cast<int>(width * this->config.channels),
+                   destination,
+                   this->config.width, this->config.height, 0,
+                   PixelLayoutOf(this->config.channels)) != nullptr;
+    }
+
+    /**
+     * @brief Flip and adjust brightness / contrast of the resized image in place
+     * @param destination
+     * @param sample_seed null when the image is not augmented
+     */
+    void Jitter(uint8_t *destination, const uint64_t *sample_seed)
+    {
+        if (sample_seed == nullptr)
+        {
+            return;
+        }
+        lantern::data::PixelJitter jitter = lantern::data::DrawJitter(this->config.augmentation, *sample_seed);
+        if (jitter.flip)
+        {
+            lantern::data::FlipHorizontal(destination, this->config.width, this->config.height, this->config.channels);
+        }
+        if (jitter.gain != 1.0f || jitter.bias != 0.0f)
+        {
+            lantern::data::AdjustGainBias(destination, this->image_size, this->config.channels, jitter.gain, jitter.bias);
+        }
+    }
+
+    /**
+     * @brief Copy image already resized to the output shape into destination, with the
+     * augmentation of the sample when sample_seed is set
+     * @param source
+     * @param destination
+     * @param sample_seed
+     * @return bool
+     */
+    bool Place(const uint8_t *source, uint8_t *destination, const uint64_t *sample_seed)
+    {
+        if (sample_seed != nullptr && this->config.augmentation.HasCrop())
+        {
+            if (!this->CropResize(source, this->config.width, this->config.height, destination, *sample_seed))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            std::memcpy(destination, source, this->image_size);
+        }
+        this->Jitter(destination, sample_seed);
+        return true;
+    }
+
+    /**
+     * @brief Decode and resize image into destination buffer, no lock held here
+     * @param image_path
+     * @param destination
+     * @param encoded encoded file already in memory, decoded instead of reading the path
+     * @param encoded_size
+     * @param sample_seed resize the random crop of the sample from the full image, null to resize the whole image
+     * @return bool false when the image cannot be loaded
+     */
+    bool Decode(const std::string &image_path, uint8_t *destination, const uint8_t *encoded = nullptr, const uint32_t &encoded_size = 0,
+                const uint64_t *sample_seed = nullptr)
+    {
+        // the random crop is taken at full resolution, so the cached whole resized image is not used
+        bool crop = sample_seed != nullptr && this->config.augmentation.HasCrop();
+        ImageDiskCache::Key key;
+        bool cacheable = !crop && encoded == nullptr && this->disk_cache.IsOpen() &&
+                         ImageDiskCache::MakeKey(image_path, this->config.width, this->config.height, this->config.channels, key);
+        if (cacheable && this->disk_cache.Load(key, destination, this->image_size))
+        {
+            return true;
+        }
+
+        int width, height, channels;
+        int desired_channels = static_cast<int>(this->config.channels);
+        uint8_t* image = encoded != nullptr
+                             ? stbi_load_from_memory(encoded, static_cast<int>(encoded_size), &width, &height, &channels, desired_channels)
+                             : stbi_load(image_path.c_str(), &width, &height, &channels, desired_channels);
+        if (!image) {
+            std::println("Error LanternImageLoader, STB cannot load image \"{}\" because {}", image_path, stbi_failure_reason());
+            return false;
+        }
+        bool resized = crop
+                           ? this->CropResize(image, static_cast<uint32_t>(width), static_cast<uint32_t>(height), destination, *sample_seed)
+                           : stbir_resize_uint8_linear(
+                                 image,
+                                 width, height, 0,
+                                 destination,
+                                 this->config.width, this->config.height, 0,
+                                 PixelLayoutOf(this->config.channels)) != nullptr;
+        stbi_image_free(image);
+        if (resized && cacheable)
+        {
+            this->disk_cache.Store(key, destination, this->image_size);
+        }
+        return resized;
+    }
+
+    /**
+     * @brief Get image at dataset index into destination, copied from the mapped shard
+     * or decoded from the image file
+     * @param _index
+     * @param destination
+     * @param label_id
+     * @param encoded file already read by the I/O stage, null to read it here
+     * @param encoded_size
+     * @param sample_seed augmentation seed of the sample, null to keep the image as is
+     * @return bool false when the image cannot be loaded
+     */
+    bool Fetch(const uint32_t &_index, uint8_t *destination, uint32_t &label_id, const uint8_t *encoded = nullptr, const uint32_t &encoded_size = 0,
+               const uint64_t *sample_seed = nullptr)
+    {
+        if (this->active_records != nullptr)
+        {
+            const ShardRecord &record = this->active_records[_index];
+            const ShardFile &shard = this->active_shards[record.shard];
+            if (!this->Place(shard.GetRecord(record.record), destination, sample_seed))
+            {
+                return false;
+            }
+            label_id = this->active_class_ids[_index];
+            return true;
+        }
+        if (this->active_arena != nullptr)
+        {
+            if (!this->active_arena->valid.getData()[_index])
+            {
+                return false;
+            }
+            if (!this->Place(this->active_arena->pixels.get() + (size_t)_index * this->image_size, destination, sample_seed))
+            {
+                return false;
+            }
+            label_id = this->active_class_ids[_index];
+            return true;
+        }
+        if (encoded == nullptr && this->active_encoded != nullptr && this->active_encoded->offsets.getData()[_index] != EncodedArena::not_pinned)
+        {
+            encoded = this->active_encoded->bytes.get() + this->active_encoded->offsets.getData()[_index];
+            return this->Fetch(_index, destination, label_id, encoded, this->active_encoded->sizes.getData()[_index], sample_seed);
+        }
+        // the path is assembled from the pool into a buffer of the worker, it keep its capacity across images
+        thread_local std::string image_path;
+        this->active_image_paths->Get(_index, image_path);
+        if (!this->Decode(image_path, destination, encoded, encoded_size, sample_seed))
+        {
+            return false;
+        }
+        this->Jitter(destination, sample_seed);
+        label_id = this->active_class_ids[_index];
+        return true;
+    }
+
+    /**
+     * @brief Get id of the class name inside the active dataset, the name is added on first use
+     * @param _name
+     * @return uint32_t
+     */
+    uint32_t InternClass(const std::string &_name)
+    {
+        auto &names = this->class_names[this->active_dataset];
+        auto [it, inserted] = this->class_name_ids[this->active_dataset].try_emplace(_name, names.size());
+        if (inserted)
+        {
+            names.push_back(_name);
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Rebuild the sampler class sizes of the active dataset from its grouped class ids, one entry
+     * per class run so a class added from several folders is one stratum and empty folders add none
+     */
+    void CountClassSizes()
+    {
+        auto &ids = this->image_class_ids[this->active_dataset];
+        auto &sizes = this->each_class_sizes[this->active_dataset];
+        sizes.clean();
+        uint32_t run = 0;
+        for (uint32_t i = 0; i < ids.size(); i++)
+        {
+            if (i > 0 && ids.getData()[i - 1] != ids.getData()[i])
+            {
+                sizes.push_back(run);
+                run = 0;
+            }
+            run++;
+        }
+        if (run > 0)
+        {
+            sizes.push_back(run);
+        }
+    }
+
+    /**
+     * @brief Keep every class of the active dataset contiguous as the sampler need. When a class added again
+     * later, e.g. two folders with the same name under different parents, its images are moved next to the
+     * images it already has, the order inside every class is kept
+     */
+    void GroupByClass()
+    {
+        auto &ids = this->image_class_ids[this->active_dataset];
+        uint32_t total_class = this->class_names[this->active_dataset].size();
+        lantern::utility::Vector<uint32_t> class_begin(total_class + 1, 0);
+        lantern::utility::Vector<uint8_t> closed(std::max<uint32_t>(total_class, 1), 0);
+        bool grouped = true;
+        for (uint32_t i = 0; i < ids.size(); i++)
+        {
+            uint32_t id = ids.getData()[i];
+            if (i > 0 && ids.getData()[i - 1] != id)
+            {
+                closed.getData()[ids.getData()[i - 1]] = 1;
+                grouped = grouped && closed.getData()[id] == 0;
+            }
+            class_begin.getData()[id + 1]++;
+        }
+        if (grouped)
+        {
+            this->CountClassSizes();
+            return;
+        }
+
+        // stable counting sort of the images by class id
+        for (uint32_t c = 0; c < total_class; c++)
+        {
+            class_begin.getData()[c + 1] += class_begin.getData()[c];
+        }
+        lantern::utility::Vector<uint32_t> order(ids.size());
+        order.explicitTotalItem(ids.size());
+        for (uint32_t i = 0; i < ids.size(); i++)
+        {
+            order.getData()[class_begin.getData()[ids.getData()[i]]++] = i;
+        }
+
+        lantern::utility::Vector<uint32_t> grouped_ids(ids.size());
+        auto &paths = this->image_paths[this->active_dataset];
+        auto &records = this->shard_records[this->active_dataset];
+        if (!paths.Empty())
+        {
+            lantern::utility::PathPool grouped_paths(paths.GetLayout());
+            std::string path;
+            for (uint32_t i = 0; i < order.size(); i++)
+            {
+                paths.Get(order.getData()[i], path);
+                grouped_paths.Push(path);
+            }
+            paths = std::move(grouped_paths);
+        }
+        else
+        {
+            lantern::utility::Vector<ShardRecord> grouped_records(records.size());
+            for (uint32_t i = 0; i < order.size(); i++)
+            {
+                grouped_records.push_back(records.getData()[order.getData()[i]]);
+            }
+            records = std::move(grouped_records);
+        }
+        for (uint32_t i = 0; i < order.size(); i++)
+        {
+            grouped_ids.push_back(ids.getData()[order.getData()[i]]);
+        }
+        ids = std::move(grouped_ids);
+        this->CountClassSizes();
+    }
+
+    /**
+     * @brief Decode every image of the active dataset into its arena with several threads,
+     * the arena is kept until the dataset or the output shape change
+     * @param _total_workers
+     */
+    void BuildArena(const uint32_t &_total_workers)
+    {
+        auto &_image_paths = this->image_paths[this->active_dataset];
+        auto &arena = this->decoded_arenas[this->active_dataset];
+        if (arena.pixels && arena.width == this->config.width && arena.height == this->config.height &&
+            arena.channels == this->config.channels && arena.total_images == _image_paths.Size())
+        {
+            return;
+        }
+        arena = DecodedArena();
+        arena.pixels = std::make_unique_for_overwrite<uint8_t[]>((size_t)_image_paths.Size() * this->image_size);
+        arena.valid = lantern::utility::Vector<uint8_t>(_image_paths.Size());
+        arena.valid.explicitTotalItem(_image_paths.Size());
+
+        std::atomic<uint32_t> next = 0;
+        auto decode = [&]()
+        {
+            std::string path;
+            for (uint32_t i = next++; i < _image_paths.Size(); i = next++)
+            {
+                _image_paths.Get(i, path);
+                arena.valid.getData()[i] = this->Decode(path, arena.pixels.get() + (size_t)i * this->image_size);
+            }
+        };
+        lantern::utility::Vector<std::thread> workers;
+        for (uint32_t i = 1; i < std::min(_total_workers, _image_paths.Size()); i++)
+        {
+            workers.push_back(std::thread(decode));
+        }
+        decode();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        bool any_valid = false;
+        for (uint32_t i = 0; i < _image_paths.Size() && !any_valid; i++)
+        {
+            any_valid = arena.valid.getData()[i];
+        }
+        if (!any_valid)
+        {
+            arena = DecodedArena();
+            throw std::runtime_error("Error LanternImageLoader, cannot load any image of the dataset");
+        }
+        arena.width = this->config.width;
+        arena.height = this->config.height;
+        arena.channels = this->config.channels;
+        arena.total_images = _image_paths.Size();
+    }
+
+    /**
+     * @brief Read encoded files of the active dataset into RAM with several threads, files are
+     * pinned in dataset order until the budget is used, the rest stay on disk. The arena is kept
+     * until the dataset or the budget change
+     * @param _total_workers
+     */
+    void BuildEncodedArena(const uint32_t &_total_workers)
+    {
+        auto &_image_paths = this->image_paths[this->active_dataset];
+        auto &arena = this->encoded_arenas[this->active_dataset];
+        if (arena.bytes && arena.budget == this->config.encoded_cache_budget && arena.total_images == _image_paths.Size())
+        {
+            return;
+        }
+        arena = EncodedArena();
+        arena.offsets = lantern::utility::Vector<uint64_t>(_image_paths.Size(), EncodedArena::not_pinned);
+        arena.sizes = lantern::utility::Vector<uint32_t>(_image_paths.Size(), 0);
+        std::string path;
+        for (uint32_t i = 0; i < _image_paths.Size(); i++)
+        {
+            std::error_code error;
+            _image_paths.Get(i, path);
+            uint64_t size = std::filesystem::file_size(path, error);
+            if (error || size == 0 || size > static_cast<uint64_t>(std::numeric_limits<int>::max()) ||
+                arena.used + size > this->config.encoded_cache_budget)
+            {
+                continue;
+            }
+            arena.offsets.getData()[i] = arena.used;
+            arena.sizes.getData()[i] = static_cast<uint32_t>(size);
+            arena.used += size;
+        }
+        arena.bytes = std::make_unique_for_overwrite<uint8_t[]>(std::max<uint64_t>(arena.used, 1));
+
+        std::atomic<uint32_t> next = 0, pinned = 0;
+        auto read = [&]()
+        {
+            std::string path;
+            for (uint32_t i = next++; i < _image_paths.Size(); i = next++)
+            {
+                if (arena.offsets.getData()[i] == EncodedArena::not_pinned)
+                {
+                    continue;
+                }
+                _image_paths.Get(i, path);
+                std::ifstream file(path, std::ios::binary);
+                if (!file.read(reinterpret_cast<char *>(arena.bytes.get() + arena.offsets.getData()[i]), arena.sizes.getData()[i]))
+                {
+                    // file changed since the size was read, keep it on disk
+                    arena.offsets.getData()[i] = EncodedArena::not_pinned;
+                    continue;
+                }
+                pinned++;
+            }
+        };
+        lantern::utility::Vector<std::thread> workers;
+        for (uint32_t i = 1; i < std::min(_total_workers, _image_paths.Size()); i++)
+        {
+            workers.push_back(std::thread(read));
+        }
+        read();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        arena.budget = this->config.encoded_cache_budget;
+        arena.total_images = _image_paths.Size();
+        arena.total_pinned = pinned;
+    }
+
+    /**
+     * @brief Draw the indices of one batch slot and record the sampler position of the slot,
+     * sampler_mutex must be held
+     * @param indices
+     * @param slot
+     */
+    void DrawBatch(uint32_t *indices, const uint32_t &slot)
+    {
+        this->sampler.Next(indices, this->config.batch_size);
+        uint32_t total_class = this->sampler.GetTotalClass();
+        this->slot_cursors[slot] = this->sampler.GetCursor();
+        this->sampler.CopyClassTaken(this->slot_class_taken.getData() + (size_t)slot * total_class);
+    }
+
+    /**
+     * @brief Remember the sampler position of the slot taken by the consumer, consumer_mutex must be held
+     * @param slot
+     */
+    void MarkConsumed(const uint32_t &slot)
+    {
+        uint32_t total_class = this->sampler.GetTotalClass();
+        this->consumed_cursor = this->slot_cursors[slot];
+        std::memcpy(this->consumed_class_taken.getData(), this->slot_class_taken.getData() + (size_t)slot * total_class, (size_t)total_class * sizeof(uint32_t));
+    }
+
+    /**
+     * @brief Get the sampler indices that enter the prefetch window after a draw, sampler_mutex must be held
+     * @param lookahead
+     * @return uint32_t total indices
+     */
+    uint32_t NextPrefetchWindow(lantern::utility::Vector<uint32_t> &lookahead)
+    {
+        uint32_t position = this->sampler.GetPosition();
+        if (this->prefetch_epoch != this->sampler.GetEpoch() || this->prefetch_until < position)
+        {
+            this->prefetch_epoch = this->sampler.GetEpoch();
+            this->prefetch_until = position;
+        }
+        uint32_t until = std::min(position + this->config.prefetch_lookahead, this->sampler.GetTotal());
+        if (until <= this->prefetch_until)
+        {
+            return 0;
+        }
+        // the lookahead can give one extra index per class
+        uint32_t room = lookahead.getCapacity() - this->sampler.GetTotalClass();
+        uint32_t from = std::max(this->prefetch_until, until - std::min(until, room));
+        uint32_t total = this->sampler.Lookahead(from, until, lookahead.getData());
+        this->prefetch_until = until;
+        return total;
+    }
+
+    /**
+     * @brief Hint the OS to read the files of the indices into page cache
+     * @param indices
+     * @param total
+     */
+    void Prefetch(const uint32_t *indices, const uint32_t &total)
+    {
+        std::string path;
+        for (uint32_t i = 0; i < total; i++)
+        {
+            if (this->active_encoded != nullptr && this->active_encoded->offsets.getData()[indices[i]] != EncodedArena::not_pinned)
+            {
+                continue;
+            }
+            this->active_image_paths->Get(indices[i], path);
+            lantern::utility::AdviseWillNeed(path);
+        }
+    }
+
+    /**
+     * @brief Reserve the next ring slot and draw its indices
+     * @param pos
+     * @param slot
+     * @param indices
+     * @param lookahead scratch of the worker for the prefetch window
+     * @return bool false when the loader was stopped
+     */
+    bool ReserveBatch(uint64_t &pos, uint32_t &slot, uint32_t *indices, lantern::utility::Vector<uint32_t> &lookahead)
+    {
+        while (true)
+        {
+            uint32_t total_prefetch = 0;
+            {
+                // reserve and draw together so the ring order follow the sampler order,
+                // this keep the sampler position recorded for every slot exact
+                std::lock_guard<std::mutex> lock(this->sampler_mutex);
+                if (this->stop_thread)
+                {
+                    return false;
+                }
+                if (this->ring.TryReserveWrite(pos))
+                {
+                    slot = this->ring.SlotOf(pos);
+                    this->DrawBatch(indices, slot);
+                    if (this->prefetch_active)
+                    {
+                        total_prefetch = this->NextPrefetchWindow(lookahead);
+                    }
+                }
+                else
+                {
+                    pos = ~0ULL;
+                }
+            }
+            if (pos != ~0ULL)
+            {
+                // the hints are given outside the lock, they only cost an open and a fadvise per file
+                this->Prefetch(lookahead.getData(), total_prefetch);
+                return true;
+            }
+            // ring full, wait outside the lock so the consumer and other workers are not blocked
+            if (!this->ring.WaitWritable())
+            {
+                return false;
+            }
+        }
+    }
+
+    /**
+     * @brief Collate the images of the indices directly into the reserved slot and publish it
+     * @param pos
+     * @param indices
+     * @param decoded scratch flags, one per image of the batch
+     * @param encoded files read by the I/O stage, null when the images are read here
+     * @param encoded_offsets
+     * @param encoded_sizes
+     * @return bool false when no image of the dataset can be loaded
+     */
+    bool FillBatch(const uint64_t &pos, const uint32_t *indices, uint8_t *decoded,
+                   const uint8_t *encoded = nullptr, const uint64_t *encoded_offsets = nullptr, const uint32_t *encoded_sizes = nullptr)
+    {
+        uint32_t batch_size = this->config.batch_size;
+        uint32_t slot = this->ring.SlotOf(pos);
+        uint8_t *batch = this->active_image_cache + (size_t)slot * this->batch_stride;
+        uint32_t *batch_labels = this->active_label_cache + (size_t)slot * batch_size;
+
+        // draw number of the first image, the cursor of the slot is taken right after its draw
+        uint64_t first_draw = 0;
+        if (this->augment_active)
+        {
+            const lantern::data::SamplerCursor &cursor = this->slot_cursors[slot];
+            first_draw = cursor.epoch * this->sampler.GetTotal() + cursor.position - batch_size;
+        }
+        auto seed_of = [&](const uint32_t &i, const uint32_t &index) {
+            return lantern::data::SampleSeed(this->sampler.GetSeed(), first_draw + i, index);
+        };
+
+        uint32_t first_valid = batch_size;
+        for (uint32_t i = 0; i < batch_size; i++)
+        {
+            bool read = encoded != nullptr && encoded_sizes[i] > 0;
+            uint64_t sample_seed = this->augment_active ? seed_of(i, indices[i]) : 0;
+            decoded[i] = this->Fetch(indices[i], batch + (size_t)i * this->image_size, batch_labels[i],
+                                     read ? encoded + encoded_offsets[i] : nullptr, read ? encoded_sizes[i] : 0,
+                                     this->augment_active ? &sample_seed : nullptr);
+            if (decoded[i])
+            {
+                first_valid = std::min(first_valid, i);
+            }
+        }
+        // every image of the batch was broken, take the next loadable image of the dataset,
+        // it only depend on the dataset so the slot keep the same content on every run
+        for (uint32_t k = 1; first_valid == batch_size && k < this->active_total_images && !this->stop_thread; k++)
+        {
+            uint32_t index = static_cast<uint32_t>(((uint64_t)indices[0] + k) % this->active_total_images);
+            uint64_t sample_seed = this->augment_active ? seed_of(0, index) : 0;
+            if (this->Fetch(index, batch, batch_labels[0], nullptr, 0, this->augment_active ? &sample_seed : nullptr))
+            {
+                decoded[0] = true;
+                first_valid = 0;
+            }
+        }
+        if (first_valid == batch_size)
+        {
+            if (!this->stop_thread)
+            {
+                std::println("Error LanternImageLoader, cannot load any image of dataset \"{}\"", this->active_dataset);
+            }
+            return false;
+        }
+
+        // broken image is replaced by a valid image of the same batch, so the batch keep its sampler position
+        for (uint32_t i = 0; i < batch_size; i++)
+        {
+            if (!decoded[i])
+            {
+                std::memcpy(batch + (size_t)i * this->image_size, batch + (size_t)first_valid * this->image_size, this->image_size);
+                batch_labels[i] = batch_labels[first_valid];
+            }
+        }
+        this->ring.PublishWrite(pos);
+        return true;
+    }
+
+    /**
+     * @brief Size of the worker scratch for prefetch windows, the first window is the whole
+     * lookahead, plus one index per class from the quota rounding
+     * @return uint32_t
+     */
+    uint32_t PrefetchScratchSize() const
+    {
+        if (!this->prefetch_active)
+        {
+            return 1;
+        }
+        return this->config.prefetch_lookahead + this->sampler.GetTotalClass() + 1;
+    }
+
+    /**
+     * @brief Reserve a batch slot, collate decoded images directly into it and publish it
+     */
+    void Loaders()
+    {
+        uint32_t batch_size = this->config.batch_size;
+        lantern::utility::Vector<uint32_t> indices(batch_size);
+        lantern::utility::Vector<uint8_t> decoded(batch_size);
+        lantern::utility::Vector<uint32_t> lookahead(this->PrefetchScratchSize());
+        while (true)
+        {
+            uint64_t pos;
+            uint32_t slot;
+            if (!this->ReserveBatch(pos, slot, indices.getData(), lookahead) || !this->FillBatch(pos, indices.getData(), decoded.getData()))
+            {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief I/O stage, reserve a batch slot, read the files of the batch into the slot read
+     * buffer and pass the slot to the decode workers
+     */
+    void IOLoaders()
+    {
+        uint32_t batch_size = this->config.batch_size;
+        lantern::utility::FileBatchReader reader(this->config.io_queue_depth);
+        lantern::utility::Vector<uint32_t> indices(batch_size);
+        lantern::utility::Vector<uint32_t> lookahead(this->PrefetchScratchSize());
+        lantern::utility::Vector<const std::string *> paths(batch_size);
+        paths.explicitTotalItem(batch_size);
+        std::unique_ptr<std::string[]> path_storage = std::make_unique<std::string[]>(batch_size);
+        while (true)
+        {
+            uint64_t pos, io_pos;
+            uint32_t slot;
+            if (!this->ReserveBatch(pos, slot, indices.getData(), lookahead))
+            {
+                return;
+            }
+            size_t first = (size_t)slot * batch_size;
+            std::memcpy(this->slot_indices.getData() + first, indices.getData(), (size_t)batch_size * sizeof(uint32_t));
+            for (uint32_t i = 0; i < batch_size; i++)
+            {
+                this->active_image_paths->Get(indices.getData()[i], path_storage[i]);
+                paths.getData()[i] = &path_storage[i];
+            }
+            reader.Read(paths.getData(), batch_size, this->slot_read_buffers[slot],
+                        this->slot_read_offsets.getData() + first, this->slot_read_sizes.getData() + first);
+            // io_ring has the same capacity as the ring, so it never wait here
+            if (!this->io_ring.ReserveWrite(io_pos))
+            {
+                return;
+            }
+            this->io_positions[this->io_ring.SlotOf(io_pos)] = pos;
+            this->io_ring.PublishWrite(io_pos);
+        }
+    }
+
+    /**
+     * @brief Decode stage, take the slots read by the I/O stage, decode from memory and publish them
+     */
+    void DecodeLoaders()
+    {
+        uint32_t batch_size = this->config.batch_size;
+        lantern::utility::Vector<uint8_t> decoded(batch_size);
+        while (true)
+        {
+            uint64_t io_pos;
+            if (!this->io_ring.ReserveRead(io_pos))
+            {
+                return;
+            }
+            uint64_t pos = this->io_positions[this->io_ring.SlotOf(io_pos)];
+            this->io_ring.ReleaseRead(io_pos);
+            uint32_t slot = this->ring.SlotOf(pos);
+            size_t first = (size_t)slot * batch_size;
+            if (!this->FillBatch(pos, this->slot_indices.getData() + first, decoded.getData(), this->slot_read_buffers[slot].getData(),
+                                 this->slot_read_offsets.getData() + first, this->slot_read_sizes.getData() + first))
+            {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Drop the reference held by the Get() cursor
+     */
+    void DropCursor()
+    {
+        if (this->has_cursor)
+        {
+            this->has_cursor = false;
+            ReleaseRingPosition(&this->ring, &this->slot_refs[this->ring.SlotOf(this->cursor_pos)], this->cursor_pos);
+        }
+    }
+
+    std::unordered_set<std::string> extension_accepted = {
+        ".jpg", ".jpeg", ".png", ".bmp", ".tiff", ".webp"
+    };
+    /**
+     * @brief Check if the file extension was an image or not
+     * @param path 
+     * @return bool
+     */
+    bool IsImage(const std::filesystem::path& path){
+
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        return this->extension_accepted.find(ext) != this->extension_accepted.end();
+
+    }
+
+    /**
+     * @brief GetAsAF body, convert(source, destination) write one image in the output format
+     */
+    template <typename Convert>
+    bool ImageAsAF(af::array &img, uint32_t &label_id, Convert &&convert)
+    {
+        this->CheckDatasetValid();
+        ImageLease lease = this->Get();
+        if (!lease)
+        {
+            return false;
+        }
+        af::dim4 shape = this->OutputShape(1);
+        af_dtype type = lantern::data::AFTypeOf(this->config.output_type);
+        if (IsHostBackend())
+        {
+            // array memory is host memory, convert straight into it
+            img = af::array(shape, type);
+            convert(lease.GetData(), HostDataOf(img));
+            img.unlock();
+            label_id = lease.GetLabelId();
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(this->staging_mutex);
+        if (this->af_staging_capacity < this->output_size)
+        {
+            this->af_staging = std::make_unique_for_overwrite<uint8_t[]>(this->output_size);
+            this->af_staging_capacity = this->output_size;
+        }
+        convert(lease.GetData(), this->af_staging.get());
+        label_id = lease.GetLabelId();
+        lease.Release();
+        img = af::array(shape, type);
+        WriteArray(img, this->af_staging.get(), this->output_size);
+        return true;
+    }
+
+    /**
+     * @brief GetBatchAsAF body, convert(source, destination) write one image in the output format
+     */
+    template <typename Convert>
+    bool BatchAsAF(af::array &batch, lantern::utility::Vector<uint32_t> &_label_ids, Convert &&convert)
+    {
+        this->CheckDatasetValid();
+        BatchLease lease = this->GetBatch();
+        if (!lease)
+        {
+            return false;
+        }
+        uint32_t total = lease.Size();
+        size_t bytes = this->output_size * total;
+        af::dim4 shape = this->OutputShape(total);
+        af_dtype type = lantern::data::AFTypeOf(this->config.output_type);
+        af::dim4 current = batch.dims();
+        bool reuse = batch.type() == type && current[0] == shape[0] && current[1] == shape[1] && current[2] == shape[2] && current[3] == shape[3];
+        if (!reuse)
+        {
+            batch = af::array(shape, type);
+        }
+        auto convert_all = [&](uint8_t *_destination)
+        {
+            _label_ids.clean();
+            for (uint32_t i = 0; i < total; i++)
+            {
+                convert(lease.GetImage(i), _destination + i * this->output_size);
+                _label_ids.push_back(lease.GetLabelIds()[i]);
+            }
+            lease.Release();
+        };
+
+        if (IsHostBackend())
+        {
+            // array memory is host memory, convert straight into it without staging
+            convert_all(static_cast<uint8_t *>(HostDataOf(batch)));
+            batch.unlock();
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(this->staging_mutex);
+        if (this->af_batch_capacity < bytes)
+        {
+            this->af_batch_staging.reset(static_cast<uint8_t *>(af::pinned(bytes, u8)));
+            this->af_batch_capacity = bytes;
+        }
+        convert_all(this->af_batch_staging.get());
+        WriteArray(batch, this->af_batch_staging.get(), bytes);
+        return true;
+    }
+
+public:
+    LanternDynamicImageLoader() = default;
+    explicit LanternDynamicImageLoader(const LanternImageLoaderConfig &_config)
+    {
+        this->SetConfig(_config);
+    }
+
+    LanternDynamicImageLoader(const LanternDynamicImageLoader &) = delete;
+    LanternDynamicImageLoader &operator=(const LanternDynamicImageLoader &) = delete;
+
+    /**
+     * @brief Set the whole configuration, must be called before Run(). Width and height may stay 0
+     * until SetShape(), so the setters can be called in any order, Run() reject an unset shape
+     * @param _config
+     */
+    void SetConfig(const LanternImageLoaderConfig &_config)
+    {
+        if (!this->thread_loaders.empty())
+        {
+            throw std::runtime_error("Error LanternImageLoader, cannot change configuration while loader running");
+        }
+        if (_config.batch_size == 0)
+        {
+            throw std::runtime_error("Error LanternImageLoader, batch size must be greater than zero");
+        }
+        if (_config.queue_depth < 2)
+        {
+            throw std::runtime_error("Error LanternImageLoader, queue depth must be at least 2");
+        }
+        if (_config.channels == 0 || _config.channels > 4)
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, invalid total channels {}", _config.channels));
+        }
+        if (_config.world_size == 0 || _config.rank >= _config.world_size)
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, invalid rank {} for world size {}", _config.rank, _config.world_size));
+        }
+        for (uint32_t c = 0; c < _config.channels; c++)
+        {
+            if (_config.normalization.stddev[c] == 0.0f)
+            {
+                throw std::runtime_error(std::format("Error LanternImageLoader, normalization stddev of channel {} is zero", c));
+            }
+        }
+        if (!_config.augmentation.IsValid())
+        {
+            throw std::runtime_error("Error LanternImageLoader, invalid augmentation range");
+        }
+        this->converter = lantern::data::ConverterOf(_config.channels, _config.output_type, _config.output_layout);
+        this->config = _config;
+        this->image_size = (size_t)_config.width * _config.height * _config.channels;
+        this->output_size = this->image_size * lantern::data::SizeOf(_config.output_type);
+    }
+
+    const LanternImageLoaderConfig &GetConfig() const
+    {
+        return this->config;
+    }
+
+    /**
+     * @brief Set total batch slots inside the ring, must be called before Run()
+     * @param _queue_depth
+     */
+    void SetQueueDepth(const uint32_t &_queue_depth)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.queue_depth = _queue_depth;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Set output shape of every image, must be called before Run()
+     * @param _width
+     * @param _height
+     * @param _channels
+     */
+    void SetShape(const uint32_t &_width, const uint32_t &_height, const uint32_t &_channels)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.width = _width;
+        _config.height = _height;
+        _config.channels = _channels;
+        this->SetConfig(_config);
+    }
+
+    size_t GetImageSize() const
+    {
+        return this->image_size;
+    }
+
+    /**
+     * @brief Get the sampler state right after the last batch taken by the consumer, images
+     * already prefetched in the ring are not counted, so a job restored with this state
+     * continue exactly after the last consumed batch. Save it with the model checkpoint.
+     * When Get() is used with batch size greater than 1, the rest of the current batch is skipped on resume.
+     * @return lantern::data::SamplerState
+     */
+    lantern::data::SamplerState GetSamplerState()
+    {
+        std::lock_guard<std::mutex> lock(this->consumer_mutex);
+        lantern::data::SamplerState state;
+        state.seed = this->sampler.GetSeed();
+        state.total = this->sampler.GetTotal();
+        state.rank = this->sampler.GetRank();
+        state.world_size = this->sampler.GetWorldSize();
+        state.cursor = this->consumed_cursor;
+        for (uint32_t c = 0; c < this->consumed_class_taken.size(); c++)
+        {
+            state.class_taken.push_back(this->consumed_class_taken.getData()[c]);
+        }
+        return state;
+    }
+
+    /**
+     * @brief Resume the sampler from saved state on the next Run(), the state seed replace the configured seed
+     * @param _state
+     */
+    void SetSamplerState(const lantern::data::SamplerState &_state)
+    {
+        if (!this->thread_loaders.empty())
+        {
+            throw std::runtime_error("Error LanternImageLoader, cannot restore sampler state while loader running");
+        }
+        this->pending_sampler_state.emplace(_state);
+    }
+
+    /**
+     * @brief Set the sampler seed, must be called before Run()
+     * @param _seed
+     */
+    void SetSeed(const uint64_t &_seed)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.seed = _seed;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Augment every image before it enter the ring, the augmentation of a sample only
+     * depend on the seed and its sampler draw so it is the same on every run and worker count.
+     * Must be called before Run()
+     * @param _augmentation
+     */
+    void SetAugmentation(const lantern::data::Augmentation &_augmentation)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.augmentation = _augmentation;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Only sample the shard of this process in data-parallel training, every process
+     * must use the same seed and dataset. Must be called before Run()
+     * @param _rank
+     * @param _world_size
+     */
+    void SetShard(const uint32_t &_rank, const uint32_t &_world_size)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.rank = _rank;
+        _config.world_size = _world_size;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Keep the resized images in the directory, so later epochs and runs read the
+     * small raw pixels instead of decode and resize again. Empty directory disable the cache.
+     * Must be called before Run()
+     * @param _directory
+     */
+    void SetDiskCache(const std::string &_directory)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.cache_directory = _directory;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Decode the whole folder dataset once on Run() and serve every epoch from RAM,
+     * the workers then only copy pixels. Need total images x image size bytes of memory.
+     * Must be called before Run()
+     * @param _in_memory
+     */
+    void SetInMemory(const bool &_in_memory)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.in_memory = _in_memory;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Free the decoded images and encoded files kept in RAM for the dataset
+     * @param _dataset_name
+     */
+    void ReleaseInMemory(const std::string &_dataset_name)
+    {
+        if (!this->thread_loaders.empty() && _dataset_name == this->active_dataset)
+        {
+            throw std::runtime_error("Error LanternImageLoader, cannot release the active dataset while loader running");
+        }
+        this->decoded_arenas.erase(_dataset_name);
+        this->encoded_arenas.erase(_dataset_name);
+    }
+
+    /**
+     * @brief Keep the encoded image files in RAM up to the budget in bytes, the workers decode
+     * them from memory so no file is read after Run(). Files beyond the budget are read from disk.
+     * Used when the decoded dataset do not fit in RAM, 0 disable it. Must be called before Run()
+     * @param _budget_bytes
+     */
+    void SetEncodedCacheBudget(const uint64_t &_budget_bytes)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.encoded_cache_budget = _budget_bytes;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Read the image files in separate I/O threads ahead of the decode workers, so disk
+     * queue depth and decode parallelism are tuned separately. The reads use io_uring when built
+     * with LANTERN_USE_IO_URING and liburing, otherwise every I/O thread read its files in turn.
+     * Only used for folder datasets without disk cache or RAM cache. Must be called before Run()
+     * @param _io_workers total I/O threads, 0 disable the I/O stage
+     * @param _io_queue_depth reads in flight per I/O thread with io_uring
+     */
+    void SetIOStage(const uint32_t &_io_workers, const uint32_t &_io_queue_depth = 32)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.io_workers = _io_workers;
+        _config.io_queue_depth = _io_queue_depth;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Hint the OS to read the next image files of the sampler into page cache ahead of the
+     * workers, so the file is already in memory when a worker reach it. Used for folder datasets
+     * without disk cache or decoded RAM cache, the window stop at the end of the epoch. Must be called before Run()
+     * @param _lookahead total images ahead of the sampler, 0 disable the prefetch
+     */
+    void SetPrefetch(const uint32_t &_lookahead)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.prefetch_lookahead = _lookahead;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Set how the image paths of folder datasets are kept in memory. Plain store every file
+     * name once in one arena, FrontCoded only keep the part of a name not shared with the name before,
+     * for datasets of millions of files. Paths already added are stored again on the next GetImagesDataFromFolder
+     * @param _layout
+     */
+    void SetPathLayout(const lantern::utility::PathLayout &_layout)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.path_layout = _layout;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Set the normalization of GetAsAF, every value become (pixel * scale - mean[c]) / stddev[c]
+     * @param _mean per channel, only the first channels are used
+     * @param _stddev per channel, only the first channels are used
+     * @param _scale applied to the raw pixel before mean and stddev
+     */
+    void SetNormalization(const std::array<float, 4> &_mean, const std::array<float, 4> &_stddev, const float &_scale = 1.0f / 255.0f)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.normalization.mean = _mean;
+        _config.normalization.stddev = _stddev;
+        _config.normalization.scale = _scale;
+        this->SetConfig(_config);
+    }
+
+    /**
+     * @brief Get how many images of the active dataset are kept encoded in RAM and their bytes
+     * @return std::pair<uint32_t, uint64_t>
+     */
+    std::pair<uint32_t, uint64_t> GetEncodedCacheUsage()
+    {
+        this->CheckDatasetValid();
+        auto it = this->encoded_arenas.find(this->active_dataset);
+        if (it == this->encoded_arenas.end())
+        {
+            return {0, 0};
+        }
+        return {it->second.total_pinned, it->second.used};
+    }
+
+    /**
+     * @brief Get bytes used by the image paths of the active dataset
+     * @return size_t
+     */
+    size_t GetPathMemoryUsage()
+    {
+        this->CheckDatasetValid();
+        return this->image_paths[this->active_dataset].MemoryUsage();
+    }
+
+    /**
+     * @brief Get the next image, block until image available
+     * @return ImageLease empty lease when the loader was stopped
+     */
+    ImageLease Get()
+    {
+        uint64_t pos;
+        if (this->config.batch_size == 1)
+        {
+            if (!this->ring.ReserveRead(pos))
+            {
+                return ImageLease(); // Stop the thread if requested
+            }
+            uint32_t slot = this->ring.SlotOf(pos);
+            {
+                std::lock_guard<std::mutex> lock(this->consumer_mutex);
+                this->MarkConsumed(slot);
+            }
+            return ImageLease(&this->ring, nullptr, pos, this->active_image_cache + (size_t)slot * this->batch_stride, &this->active_label_cache[slot],
+                              this->active_class_names);
+        }
+
+        // hand out images of one batch slot one by one, the slot is released by the last lease
+        std::unique_lock<std::mutex> lock(this->consumer_mutex);
+        if (!this->has_cursor)
+        {
+            // wait for the next slot without consumer_mutex, so GetSamplerState() and Stop() are not blocked
+            // behind an empty ring, cursor_mutex keep a single consumer reserving the next slot
+            lock.unlock();
+            std::lock_guard<std::mutex> reserve(this->cursor_mutex);
+            lock.lock();
+            if (!this->has_cursor)
+            {
+                lock.unlock();
+                if (!this->ring.ReserveRead(pos))
+                {
+                    return ImageLease();
+                }
+                lock.lock();
+                if (this->stop_thread)
+                {
+                    ReleaseRingPosition(&this->ring, nullptr, pos);
+                    return ImageLease();
+                }
+                this->cursor_pos = pos;
+                this->slot_refs[this->ring.SlotOf(pos)].store(1, std::memory_order_relaxed);
+                this->MarkConsumed(this->ring.SlotOf(pos));
+                this->cursor_offset = 0;
+                this->has_cursor = true;
+            }
+        }
+        pos = this->cursor_pos;
+        uint32_t slot = this->ring.SlotOf(pos);
+        uint32_t offset = this->cursor_offset++;
+        this->slot_refs[slot].fetch_add(1, std::memory_order_relaxed);
+        ImageLease lease(
+            &this->ring, &this->slot_refs[slot], pos,
+            this->active_image_cache + (size_t)slot * this->batch_stride + (size_t)offset * this->image_size,
+            &this->active_label_cache[(size_t)slot * this->config.batch_size + offset],
+            this->active_class_names
+        );
+        if (this->cursor_offset == this->config.batch_size)
+        {
+            this->DropCursor();
+        }
+        return lease;
+    }
+
+    /**
+     * @brief Get the next whole batch, block until batch available
+     * @return BatchLease contiguous N x H x W x C images and N labels, empty lease when the loader was stopped
+     */
+    BatchLease GetBatch()
+    {
+        uint64_t pos;
+        if (!this->ring.ReserveRead(pos))
+        {
+            return BatchLease();
+        }
+        uint32_t slot = this->ring.SlotOf(pos);
+        {
+            std::lock_guard<std::mutex> lock(this->consumer_mutex);
+            this->MarkConsumed(slot);
+        }
+        return BatchLease(
+            &this->ring, pos,
+            this->active_image_cache + (size_t)slot * this->batch_stride,
+            this->active_label_cache + (size_t)slot * this->config.batch_size, this->active_class_names,
+            this->config.batch_size, this->image_size
+        );
+    }
+
+    /**
+     * @brief Get the next whole batch with the given size, size must equal to SetBatchSize()
+     * @param _batch_size
+     * @return BatchLease
+     */
+    BatchLease GetBatch(const uint32_t &_batch_size)
+    {
+        if (_batch_size != this->config.batch_size)
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, requested batch size {} but loader was configured with batch size {}", _batch_size, this->config.batch_size));
+        }
+        return this->GetBatch();
+    }
+
+    /**
+     * @brief Set total images in one ring slot, must be called before Run()
+     * @param _batch_size
+     */
+    void SetBatchSize(const uint32_t &_batch_size)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.batch_size = _batch_size;
+        this->SetConfig(_config);
+    }
+
+    uint32_t GetBatchSize() const
+    {
+        return this->config.batch_size;
+    }
+
+    /**
+     * @brief Get class name of the class id inside the active dataset, class ids are given in the
+     * order the class names are first seen by GetImagesDataFromFolder or GetImagesDataFromShards
+     * @param _label_id
+     * @return const std::string&
+     */
+    const std::string &GetClassName(const uint32_t &_label_id)
+    {
+        this->CheckDatasetValid();
+        auto &names = this->class_names[this->active_dataset];
+        if (_label_id >= names.size())
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, class id {} out of bound", _label_id));
+        }
+        return names.getData()[_label_id];
+    }
+
+    /**
+     * @brief Get class id of the class name inside the active dataset
+     * @param _name
+     * @return uint32_t
+     */
+    uint32_t GetClassId(const std::string &_name)
+    {
+        this->CheckDatasetValid();
+        auto &ids = this->class_name_ids[this->active_dataset];
+        auto it = ids.find(_name);
+        if (it == ids.end())
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, class \"{}\" not found in dataset", _name));
+        }
+        return it->second;
+    }
+
+    uint32_t GetTotalClass()
+    {
+        this->CheckDatasetValid();
+        return this->class_names[this->active_dataset].size();
+    }
+
+    void CheckDatasetValid()
+    {
+        if (this->active_dataset.empty())
+        {
+            throw std::runtime_error("Error LanternImageLoader, No dataset selected");
+        }
+    }
+
+    void GetImagesDataFromFolder(const std::filesystem::path &_path)
+    {
+        this->CheckDatasetValid();
+        if (!this->shard_records[this->active_dataset].empty())
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, dataset \"{}\" was loaded from shards, cannot add folder", this->active_dataset));
+        }
+        if (std::filesystem::exists(_path) && std::filesystem::is_directory(_path))
+        {
+            auto &image_paths = this->image_paths[this->active_dataset];
+            image_paths.SetLayout(this->config.path_layout);
+            auto &image_class_ids = this->image_class_ids[this->active_dataset];
+            uint32_t class_size = 0, class_id = 0;
+            for (auto &file : std::filesystem::directory_iterator(_path))
+            {
+                if (this->IsImage(file))
+                {
+                    if (class_size == 0)
+                    {
+                        // every image of the folder share the folder name as label, folders with the same name are one class
+                        class_id = this->InternClass(file.path().parent_path().filename().string());
+                    }
+                    image_paths.Push(file.path().string());
+                    image_class_ids.push_back(class_id);
+                    class_size++;
+                };
+            }
+            this->GroupByClass();
+        }
+        else
+        {
+            throw std::runtime_error(std::format("Error ImageLoader, cannot access folder path \"{}\" looks like deleted or moved", _path.string()));
+        }
+    }
+
+    /**
+     * @brief Add every image under the root to the active dataset, every subdirectory of the root is one class
+     * named by the subdirectory and its images are searched recursively. The directories are listed by several
+     * threads. With a manifest path the scan is saved there, later calls load it instead of listing the tree
+     * while no directory under the root was changed
+     * @param _root
+     * @param _manifest binary manifest of the scan, empty to always scan
+     * @param _total_threads threads listing the directories, 0 to use every hardware thread
+     * @return bool true when the saved manifest was used
+     */
+    bool GetImagesDataFromTree(const std::filesystem::path &_root, const std::filesystem::path &_manifest = {}, const uint32_t &_total_threads = 0)
+    {
+        this->CheckDatasetValid();
+        if (!this->shard_records[this->active_dataset].empty())
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, dataset \"{}\" was loaded from shards, cannot add folder", this->active_dataset));
+        }
+        DatasetScanner scanner(this->extension_accepted);
+        ScanManifest scan;
+        bool loaded = !_manifest.empty() && scan.Load(_manifest, DatasetScanner::RootOf(_root), scanner.ExtensionKey());
+        if (!loaded)
+        {
+            uint32_t total_threads = _total_threads > 0 ? _total_threads : std::max<uint32_t>(1, std::thread::hardware_concurrency());
+            scan = scanner.Scan(_root, total_threads);
+            if (!_manifest.empty())
+            {
+                scan.Save(_manifest);
+            }
+        }
+
+        auto &image_paths = this->image_paths[this->active_dataset];
+        image_paths.SetLayout(this->config.path_layout);
+        auto &image_class_ids = this->image_class_ids[this->active_dataset];
+        std::string path;
+        uint32_t first = 0;
+        for (uint32_t c = 0; c < scan.class_names.size(); c++)
+        {
+            uint32_t class_id = this->InternClass(scan.class_names.getData()[c]);
+            uint32_t class_size = scan.class_sizes.getData()[c];
+            for (uint32_t i = first; i < first + class_size; i++)
+            {
+                path.assign(scan.directories.getData()[scan.file_directories.getData()[i]]);
+                path.append(scan.NameOf(i));
+                image_paths.Push(path);
+                image_class_ids.push_back(class_id);
+            }
+            first += class_size;
+        }
+        this->GroupByClass();
+        return loaded;
+    }
+
+    /**
+     * @brief Add the images listed in a CSV manifest to the active dataset, one row per image with its path
+     * and class name, so no directory is crawled. Relative paths are resolved from the folder of the manifest,
+     * the images are grouped by class name in the order the classes first appear
+     * @param _path CSV manifest
+     * @param _path_col column of the image path
+     * @param _label_col column of the class name
+     * @param _trust_manifest add every row without stat, the startup is one sequential read of the manifest
+     * and a missing image is only reported when a worker fails to load it
+     * @param _has_header skip the first row
+     * @return uint32_t total images added
+     */
+    uint32_t GetImagesFromManifest(const std::filesystem::path &_path, const uint32_t &_path_col, const uint32_t &_label_col,
+                                   const bool &_trust_manifest = false, const bool &_has_header = true)
+    {
+        this->CheckDatasetValid();
+        if (!this->shard_records[this->active_dataset].empty())
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, dataset \"{}\" was loaded from shards, cannot add manifest", this->active_dataset));
+        }
+        CSVFile manifest = ReadCSVFile(_path);
+        uint32_t first_row = _has_header ? 1 : 0;
+        if (manifest.Rows() > first_row && std::max(_path_col, _label_col) >= manifest.Cols())
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, manifest \"{}\" has no column {}", _path.string(), std::max(_path_col, _label_col)));
+        }
+        std::filesystem::path base = _path.parent_path();
+        auto resolve = [&](const uint32_t &_row)
+        {
+            std::filesystem::path image(manifest.Get<std::string>(_row, _path_col));
+            return image.is_absolute() ? image.string() : (base / image).string();
+        };
+
+        // the sampler need every class contiguous, group the rows by class name
+        static constexpr uint32_t skipped = ~0u;
+        std::unordered_map<std::string, uint32_t> class_ids;
+        lantern::utility::Vector<uint32_t> row_classes, class_sizes, dataset_ids;
+        uint32_t missing = 0;
+        for (uint32_t r = first_row; r < manifest.Rows(); r++)
+        {
+            if (!_trust_manifest)
+            {
+                std::error_code error;
+                std::filesystem::path image = resolve(r);
+                if (!std::filesystem::is_regular_file(image, error) || !this->IsImage(image))
+                {
+                    row_classes.push_back(skipped);
+                    missing++;
+                    continue;
+                }
+            }
+            auto [it, inserted] = class_ids.try_emplace(manifest.Get<std::string>(r, _label_col), class_sizes.size());
+            if (inserted)
+            {
+                class_sizes.push_back(0);
+                dataset_ids.push_back(this->InternClass(it->first));
+            }
+            class_sizes.getData()[it->second]++;
+            row_classes.push_back(it->second);
+        }
+        if (missing > 0)
+        {
+            std::println("Error LanternImageLoader, {} images of manifest \"{}\" not found, skipped", missing, _path.string());
+        }
 
-    void Put(const std::string &image_path)
-    {
-        std::unique_lock<std::mutex> lock(this->mutex);
-        this->producer.wait(lock, [this](){ return this->count < TOTAL_IMAGES || this->stop_thread; });
-        if (this->stop_thread)
+        lantern::utility::Vector<uint32_t> class_begin(class_sizes.size() + 1, 0);
+        for (uint32_t c = 0; c < class_sizes.size(); c++)
         {
-            return;
+            class_begin.getData()[c + 1] = class_begin.getData()[c] + class_sizes.getData()[c];
         }
-        this->CheckDatasetValid();
-        auto &image_data = this->image_cache[this->active_dataset];
-        auto &label_data = this->label_cache[this->active_dataset];
-        int width, height, channels;
-        stbir_pixel_layout layout = IsColor? STBIR_RGB : STBIR_1CHANNEL;
-        uint8_t* image = stbi_load(image_path.c_str(), &width, &height, &channels, IsColor ? 3 : 1);
-        if (!image) {
-            std::println("Error LanternImageLoader, STB cannot load image \"{}\" because {}", image_path, stbi_failure_reason());
-            return;
+        uint32_t total = class_begin.getData()[class_sizes.size()];
+        lantern::utility::Vector<uint32_t> order(std::max<uint32_t>(total, 1));
+        order.explicitTotalItem(total);
+        for (uint32_t r = 0; r < row_classes.size(); r++)
+        {
+            if (row_classes.getData()[r] != skipped)
+            {
+                order.getData()[class_begin.getData()[row_classes.getData()[r]]++] = first_row + r;
+            }
         }
-        try {
-            stbir_resize_uint8_linear(
-                image,
-                width, height, 0,
-                image_data.getData() + (size_t)(this->tail * IMG_WIDTH * IMG_HEIGHT * (IsColor ? 3 : 1)),
-                IMG_WIDTH, IMG_HEIGHT, 0,
-                layout
-            );
-            
-            label_data[this->tail] = std::filesystem::path(image_path).parent_path().filename().string();
-
-        } catch (...) {
-            stbi_image_free(image);
-            return;
+
+        auto &image_paths = this->image_paths[this->active_dataset];
+        image_paths.SetLayout(this->config.path_layout);
+        auto &image_class_ids = this->image_class_ids[this->active_dataset];
+        uint32_t next = 0;
+        for (uint32_t c = 0; c < class_sizes.size(); c++)
+        {
+            for (uint32_t i = 0; i < class_sizes.getData()[c]; i++)
+            {
+                image_paths.Push(resolve(order.getData()[next++]));
+                image_class_ids.push_back(dataset_ids.getData()[c]);
+            }
         }
-        stbi_image_free(image);
-        this->tail = (this->tail + 1) % TOTAL_IMAGES;
-        this->count++;
-        this->consumer.notify_all();
+        this->GroupByClass();
+        return total;
     }
 
-    void Loaders()
+    /**
+     * @brief Decode and resize every image of the active dataset once and pack them into shard files
+     * inside the directory, so the dataset can be loaded later with GetImagesDataFromShards()
+     * without decode. Broken images are skipped. Uses the current output shape.
+     * @param _directory
+     * @param _records_per_shard
+     * @param _total_workers
+     * @return uint32_t total images packed
+     */
+    uint32_t PackDatasetToShards(const std::filesystem::path &_directory, const uint32_t &_records_per_shard = 16384, const uint32_t &_total_workers = 1)
     {
-
-        this->each_class_sizes.back() -= 1;
-        lantern::utility::Vector<uint32_t> batch_indices;
-        uint32_t total_size_of_class = 0;
-        for (auto &size : this->each_class_sizes)
+        this->CheckDatasetValid();
+        if (!this->thread_loaders.empty())
+        {
+            throw std::runtime_error("Error LanternImageLoader, cannot pack dataset while loader running");
+        }
+        if (this->image_size == 0 || _records_per_shard == 0 || _total_workers == 0)
         {
-            total_size_of_class += size;
+            throw std::runtime_error("Error LanternImageLoader, output shape, records per shard and total workers must be set before packing");
         }
-        if (total_size_of_class == 0)
+        auto &_image_paths = this->image_paths[this->active_dataset];
+        if (_image_paths.Empty())
         {
             throw std::runtime_error("Error LanternImageLoader, No image found in dataset");
         }
+        std::error_code error;
+        std::filesystem::create_directories(_directory, error);
 
-        while (!this->stop_thread)
+        auto &class_names = this->class_names[this->active_dataset];
+        auto &image_labels = this->image_class_ids[this->active_dataset];
+
+        uint32_t total_shards = (_image_paths.Size() + _records_per_shard - 1) / _records_per_shard;
+        std::atomic<uint32_t> next_shard = 0, packed = 0;
+        std::mutex error_mutex;
+        std::exception_ptr failure;
+        auto pack = [&]()
         {
-            lantern::data::GetRandomSampleClassIndex<TOTAL_IMAGES>(batch_indices, this->each_class_sizes, total_size_of_class);
-            for (auto &index : batch_indices)
+            std::unique_ptr<uint8_t[]> pixels = std::make_unique_for_overwrite<uint8_t[]>(this->image_size);
+            std::string path;
+            try
             {
-                if (this->stop_thread)
+                for (uint32_t shard = next_shard++; shard < total_shards; shard = next_shard++)
                 {
-                    return;
+                    ShardWriter writer;
+                    writer.Open(_directory / std::format("shard-{:05}.lsh", shard), this->config.width, this->config.height, this->config.channels, class_names);
+                    uint32_t end = std::min<uint32_t>(_image_paths.Size(), (shard + 1) * _records_per_shard);
+                    for (uint32_t i = shard * _records_per_shard; i < end; i++)
+                    {
+                        _image_paths.Get(i, path);
+                        if (this->Decode(path, pixels.get()))
+                        {
+                            writer.Append(image_labels.getData()[i], pixels.get());
+                        }
+                    }
+                    packed += writer.Size();
+                    writer.Close();
                 }
-                auto &_image_paths = this->image_paths[this->active_dataset];
-                this->Put(_image_paths[index]);
             }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                failure = std::current_exception();
+                next_shard = total_shards;
+            }
+        };
+        lantern::utility::Vector<std::thread> workers;
+        for (uint32_t i = 1; i < std::min(_total_workers, total_shards); i++)
+        {
+            workers.push_back(std::thread(pack));
+        }
+        pack();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        if (failure)
+        {
+            std::rethrow_exception(failure);
         }
+        return packed;
     }
 
-    std::unordered_set<std::string> extension_accepted = {
-        ".jpg", ".jpeg", ".png", ".bmp", ".tiff", ".webp"
-    };
     /**
-     * @brief Check if the file extension was an image or not
-     * @param path 
-     * @return bool
+     * @brief Load packed shards into the active dataset, the path is one shard file or a
+     * directory of .lsh files. The shards are memory mapped and the workers copy the records
+     * directly into the batch slots, no decode and no file open per image.
+     * @param _path
      */
-    bool IsImage(const std::filesystem::path& path){
-
-        std::string ext = path.extension().string();
-        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
-        return this->extension_accepted.find(ext) != this->extension_accepted.end();
-
-    }
-
-public:
-    LanternImageLoader() = default;
-
-    uint8_t *Get()
+    void GetImagesDataFromShards(const std::filesystem::path &_path)
     {
-        std::unique_lock<std::mutex> lock(this->mutex);
-        this->consumer.wait(lock, [this](){ return this->count > 0 || this->stop_thread; });
-        if (this->stop_thread || this->count == 0)
+        this->CheckDatasetValid();
+        if (!this->image_paths[this->active_dataset].Empty())
         {
-            return nullptr; // Stop the thread if requested
+            throw std::runtime_error(std::format("Error LanternImageLoader, dataset \"{}\" was loaded from folders, cannot add shards", this->active_dataset));
+        }
+        if (!this->thread_loaders.empty())
+        {
+            throw std::runtime_error("Error LanternImageLoader, cannot add shards while loader running");
+        }
+        lantern::utility::Vector<std::filesystem::path> files;
+        if (std::filesystem::is_directory(_path))
+        {
+            for (auto &file : std::filesystem::directory_iterator(_path))
+            {
+                if (file.is_regular_file() && file.path().extension() == ".lsh")
+                {
+                    files.push_back(file.path());
+                }
+            }
+            std::sort(files.getData(), files.getData() + files.size());
+        }
+        else if (std::filesystem::is_regular_file(_path))
+        {
+            files.push_back(_path);
+        }
+        if (files.empty())
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, cannot find shard at \"{}\"", _path.string()));
         }
-        auto &image_data = this->image_cache[this->active_dataset];
-        uint8_t *image = image_data.getData() + (size_t)(this->head * IMG_WIDTH * IMG_HEIGHT * (IsColor ? 3 : 1));
-        this->head = (this->head + 1) % TOTAL_IMAGES;
-        this->count--;
-        this->producer.notify_all();
-        return image;
-    }
 
-    void CheckDatasetValid()
-    {
-        if (this->active_dataset.empty())
+        auto &shards = this->image_shards[this->active_dataset];
+        auto &records = this->shard_records[this->active_dataset];
+        uint32_t first_shard = shards.size();
+        for (auto &file : files)
         {
-            throw std::runtime_error("Error LanternImageLoader, No dataset selected");
+            ShardFile shard;
+            shard.Open(file);
+            if (shards.size() > 0 && (shard.GetWidth() != shards.front().GetWidth() || shard.GetHeight() != shards.front().GetHeight() ||
+                                      shard.GetChannels() != shards.front().GetChannels()))
+            {
+                throw std::runtime_error(std::format("Error LanternImageLoader, shard \"{}\" has different image shape", file.string()));
+            }
+            shards.push_back(std::move(shard));
         }
-    }
 
-    void GetImagesDataFromFolder(const std::filesystem::path &_path)
-    {
-        this->CheckDatasetValid();
-        if (std::filesystem::exists(_path) && std::filesystem::is_directory(_path))
+        // the sampler need every class contiguous, group the new records by class name
+        std::unordered_map<std::string, uint32_t> class_ids;
+        lantern::utility::Vector<uint32_t> class_sizes, dataset_ids;
+        for (uint32_t s = first_shard; s < shards.size(); s++)
         {
-            auto &image_paths = this->image_paths[this->active_dataset];
-            uint32_t class_size = 0;
-            for (auto &file : std::filesystem::directory_iterator(_path))
+            auto &shard = shards.getData()[s];
+            for (uint32_t i = 0; i < shard.Size(); i++)
             {
-                if (this->IsImage(file))
+                auto [it, inserted] = class_ids.try_emplace(shard.GetClassName(shard.GetLabelId(i)), class_sizes.size());
+                if (inserted)
                 {
-                    image_paths.push_back(file.path().string());
-                    class_size++;
-                };
+                    class_sizes.push_back(0);
+                    dataset_ids.push_back(this->InternClass(it->first));
+                }
+                class_sizes.getData()[it->second]++;
             }
-            this->each_class_sizes.push_back(class_size);
         }
-        else
+        lantern::utility::Vector<uint32_t> class_begin(class_sizes.size() + 1, 0);
+        for (uint32_t c = 0; c < class_sizes.size(); c++)
         {
-            throw std::runtime_error(std::format("Error ImageLoader, cannot access folder path \"{}\" looks like deleted or moved", _path.string()));
+            class_begin.getData()[c + 1] = class_begin.getData()[c] + class_sizes.getData()[c];
         }
+        auto &image_class_ids = this->image_class_ids[this->active_dataset];
+        uint32_t first_record = records.size();
+        for (uint32_t i = 0; i < class_begin.getData()[class_sizes.size()]; i++)
+        {
+            records.push_back(ShardRecord{0, 0});
+            image_class_ids.push_back(0);
+        }
+        for (uint32_t s = first_shard; s < shards.size(); s++)
+        {
+            auto &shard = shards.getData()[s];
+            for (uint32_t i = 0; i < shard.Size(); i++)
+            {
+                uint32_t c = class_ids[shard.GetClassName(shard.GetLabelId(i))];
+                uint32_t position = first_record + class_begin.getData()[c]++;
+                records.getData()[position] = ShardRecord{s, i};
+                image_class_ids.getData()[position] = dataset_ids.getData()[c];
+            }
+        }
+        this->GroupByClass();
     }
 
     void SelectDatasetToModify(const std::string &_dataset_name)
@@ -177,23 +1859,165 @@ public:
         {
             throw std::runtime_error(std::format("Error LanternImageLoader, Cannot create dataset \"{}\" because already exists", _dataset_name));
         }
-        this->image_cache[_dataset_name] = lantern::utility::Vector<uint8_t>(this->allocation);
+        this->image_cache[_dataset_name] = SlotCache();
     }
 
-    void Run()
+    /**
+     * @brief Start the decode workers, all workers feed the same ring buffer
+     * @param _total_workers
+     */
+    void Run(const uint32_t &_total_workers = 1)
     {
-        this->thread_loader = std::thread(&LanternImageLoader::Loaders, this);
+        this->CheckDatasetValid();
+        if (this->image_size == 0)
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, invalid output shape {}x{}, call SetShape() before Run()", this->config.width, this->config.height));
+        }
+        if (_total_workers == 0)
+        {
+            throw std::runtime_error("Error LanternImageLoader, total workers must be greater than zero");
+        }
+        if (!this->thread_loaders.empty())
+        {
+            throw std::runtime_error("Error LanternImageLoader, loader already running, call Stop() first");
+        }
+        if (this->ring.getCapacity() > 0 && this->ring.HasPendingReads())
+        {
+            throw std::runtime_error("Error LanternImageLoader, release every ImageLease before Run()");
+        }
+
+        auto &_shards = this->image_shards[this->active_dataset];
+        if (this->image_paths[this->active_dataset].Empty() && this->shard_records[this->active_dataset].empty())
+        {
+            throw std::runtime_error("Error LanternImageLoader, No image found in dataset");
+        }
+        if (_shards.size() > 0 && (_shards.front().GetWidth() != this->config.width || _shards.front().GetHeight() != this->config.height ||
+                                   _shards.front().GetChannels() != this->config.channels))
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, shards hold {}x{}x{} images but loader output shape is {}x{}x{}",
+                                                 _shards.front().GetWidth(), _shards.front().GetHeight(), _shards.front().GetChannels(),
+                                                 this->config.width, this->config.height, this->config.channels));
+        }
+        this->sampler.Setup(this->each_class_sizes[this->active_dataset], this->config.seed, this->config.rank, this->config.world_size);
+        if (this->pending_sampler_state.has_value())
+        {
+            this->sampler.SetState(*this->pending_sampler_state);
+            this->pending_sampler_state.reset();
+        }
+        if (this->config.cache_directory.empty())
+        {
+            this->disk_cache.Close();
+        }
+        else
+        {
+            this->disk_cache.Open(this->config.cache_directory);
+        }
+
+        uint32_t depth = this->config.queue_depth;
+        size_t alignment = lantern::utility::cache_line_size;
+        this->batch_stride = ((size_t)this->config.batch_size * this->image_size + alignment - 1) / alignment * alignment;
+        size_t needed = (size_t)depth * this->batch_stride + alignment;
+        auto &image_data = this->image_cache[this->active_dataset];
+        if (image_data.capacity < needed)
+        {
+            image_data.bytes = std::make_unique_for_overwrite<uint8_t[]>(needed);
+            image_data.capacity = needed;
+        }
+        uintptr_t base = reinterpret_cast<uintptr_t>(image_data.bytes.get());
+        this->active_image_cache = reinterpret_cast<uint8_t *>((base + alignment - 1) / alignment * alignment);
+
+        auto &label_data = this->label_cache[this->active_dataset];
+        while (label_data.size() < (size_t)depth * this->config.batch_size)
+        {
+            label_data.push_back(0);
+        }
+        this->active_label_cache = label_data.getData();
+        this->active_class_ids = this->image_class_ids[this->active_dataset].getData();
+        this->active_class_names = &this->class_names[this->active_dataset];
+        auto &_records = this->shard_records[this->active_dataset];
+        this->active_records = _records.empty() ? nullptr : _records.getData();
+        this->active_arena = nullptr;
+        this->active_encoded = nullptr;
+        if (this->config.in_memory && _records.empty())
+        {
+            this->BuildArena(_total_workers);
+            this->active_arena = &this->decoded_arenas[this->active_dataset];
+        }
+        else if (this->config.encoded_cache_budget > 0 && _records.empty())
+        {
+            this->BuildEncodedArena(_total_workers);
+            this->active_encoded = &this->encoded_arenas[this->active_dataset];
+        }
+        this->active_shards = _shards.getData();
+        this->active_image_paths = &this->image_paths[this->active_dataset];
+        this->active_total_images = _records.empty() ? this->image_paths[this->active_dataset].Size() : _records.size();
+
+        this->slot_refs = std::make_unique<std::atomic<uint32_t>[]>(depth);
+        uint32_t total_class = this->sampler.GetTotalClass();
+        this->slot_cursors = std::make_unique<lantern::data::SamplerCursor[]>(depth);
+        this->slot_class_taken = lantern::utility::Vector<uint32_t>((uint32_t)depth * total_class);
+        this->consumed_class_taken = lantern::utility::Vector<uint32_t>(total_class);
+        this->consumed_class_taken.explicitTotalItem(total_class);
+        this->consumed_cursor = this->sampler.GetCursor();
+        this->sampler.CopyClassTaken(this->consumed_class_taken.getData());
+        this->has_cursor = false;
+        this->stop_thread = false;
+        this->prefetch_active = this->config.prefetch_lookahead > 0 && this->active_records == nullptr &&
+                                this->active_arena == nullptr && !this->disk_cache.IsOpen();
+        this->augment_active = this->config.augmentation.IsEnabled();
+        this->prefetch_epoch = this->sampler.GetEpoch();
+        this->prefetch_until = this->sampler.GetPosition();
+
+        // the I/O stage only help when the decode workers would read image files themselves
+        this->io_stage = this->config.io_workers > 0 && this->active_records == nullptr && this->active_arena == nullptr &&
+                         this->active_encoded == nullptr && !this->disk_cache.IsOpen();
+        if (this->io_stage)
+        {
+            uint32_t total_slot_images = depth * this->config.batch_size;
+            this->io_positions = std::make_unique<uint64_t[]>(depth);
+            this->slot_read_buffers = std::make_unique<lantern::utility::Vector<uint8_t>[]>(depth);
+            this->slot_read_offsets = lantern::utility::Vector<uint64_t>(total_slot_images, 0);
+            this->slot_read_sizes = lantern::utility::Vector<uint32_t>(total_slot_images, 0);
+            this->slot_indices = lantern::utility::Vector<uint32_t>(total_slot_images, 0);
+            this->ring.Reset(depth, this->config.io_workers == 1);
+            this->io_ring.Reset(depth, this->config.io_workers == 1);
+            for (uint32_t i = 0; i < this->config.io_workers; i++)
+            {
+                this->thread_loaders.push_back(std::thread(&LanternDynamicImageLoader::IOLoaders, this));
+            }
+            for (uint32_t i = 0; i < _total_workers; i++)
+            {
+                this->thread_loaders.push_back(std::thread(&LanternDynamicImageLoader::DecodeLoaders, this));
+            }
+            return;
+        }
+        this->ring.Reset(depth, _total_workers == 1);
+        for (uint32_t i = 0; i < _total_workers; i++)
+        {
+            this->thread_loaders.push_back(std::thread(&LanternDynamicImageLoader::Loaders, this));
+        }
     }
 
     void Stop()
     {
+        this->stop_thread = true;
+        this->ring.Stop(); // Wake producers and consumers blocked on the ring
+        if (this->io_stage)
+        {
+            this->io_ring.Stop();
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->consumer_mutex);
+            this->DropCursor();
+        }
+        for (auto &worker : this->thread_loaders)
         {
-            std::lock_guard<std::mutex> lock(this->mutex);
-            this->stop_thread = true;
+            if (worker.joinable())
+            {
+                worker.join();
+            }
         }
-        this->producer.notify_all(); // Notify the producer to stop waiting
-        this->consumer.notify_all();
-        this->thread_loader.join();
+        this->thread_loaders.clean();
     }
 
     /**
@@ -205,31 +2029,144 @@ public:
         this->labels[this->active_dataset] = ReadCSVFile(_path);
     }
 
-    void GetAsAF(af::array &img){
-        this->CheckDatasetValid();
-        af::array flat(IMG_HEIGHT * IMG_WIDTH* 3, this->Get());
-        af::array R = af::moddims(flat(af::seq(0, af::end, 3)), IMG_HEIGHT, IMG_WIDTH);
-        af::array G = af::moddims(flat(af::seq(1, af::end, 3)), IMG_HEIGHT, IMG_WIDTH);
-        af::array B = af::moddims(flat(af::seq(2, af::end, 3)), IMG_HEIGHT, IMG_WIDTH);
+    /**
+     * @brief Check if the active ArrayFire backend keep arrays in host memory (CPU backend, also when
+     * picked by the unified backend), then the conversion write straight into the array
+     * @return bool
+     */
+    static bool IsHostBackend()
+    {
+        return af::getActiveBackend() == AF_BACKEND_CPU;
+    }
+
+    /**
+     * @brief Get af::array shape of converted images in the output layout
+     * @param _total total images
+     * @return af::dim4 height x width x channels x N for CWH, width x height x channels x N for CHW,
+     * channels x width x height x N for HWC
+     */
+    af::dim4 OutputShape(const uint32_t &_total) const
+    {
+        switch (this->config.output_layout)
+        {
+        case lantern::data::TensorLayout::HWC:
+            return af::dim4(this->config.channels, this->config.width, this->config.height, _total);
+        case lantern::data::TensorLayout::CHW:
+            return af::dim4(this->config.width, this->config.height, this->config.channels, _total);
+        default:
+            return af::dim4(this->config.height, this->config.width, this->config.channels, _total);
+        }
+    }
+
+    /**
+     * @brief Get host memory of the array on host backend, the array stay locked until unlock()
+     * @param _array
+     * @return void*
+     */
+    static void *HostDataOf(af::array &_array)
+    {
+        void *data = nullptr;
+        af_err error = af_get_device_ptr(&data, _array.get());
+        if (error != AF_SUCCESS)
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, cannot get array memory, ArrayFire error {}", static_cast<int>(error)));
+        }
+        return data;
+    }
 
-        img = af::join(2, R, G, B);
-        img = af::reorder(img, 1, 0, 2);
-        img = img.as(f32) / 255;
+    /**
+     * @brief Copy host data into the whole array with one transfer
+     * @param _array
+     * @param _data
+     * @param _bytes
+     */
+    static void WriteArray(af::array &_array, const void *_data, const size_t &_bytes)
+    {
+        af_err error = af_write_array(_array.get(), _data, _bytes, afHost);
+        if (error != AF_SUCCESS)
+        {
+            throw std::runtime_error(std::format("Error LanternImageLoader, cannot write array, ArrayFire error {}", static_cast<int>(error)));
+        }
+    }
+
+    /**
+     * @brief Get the next image as af::array in the output format (default f32 height x width x channels),
+     * normalized with the configured normalization (default scale to [0, 1])
+     * @param img
+     */
+    void GetAsAF(af::array &img){
+        uint32_t label_id;
+        this->GetAsAF(img, label_id);
     }
 
+    /**
+     * @brief Get the next image as af::array in the output format with its class name
+     * @param img
+     * @param label
+     */
     void GetAsAF(af::array &img, std::string &label){
-        this->CheckDatasetValid();
-        af::array flat(IMG_HEIGHT * IMG_WIDTH* 3, this->Get());
-        af::array R = af::moddims(flat(af::seq(0, af::end, 3)), IMG_HEIGHT, IMG_WIDTH);
-        af::array G = af::moddims(flat(af::seq(1, af::end, 3)), IMG_HEIGHT, IMG_WIDTH);
-        af::array B = af::moddims(flat(af::seq(2, af::end, 3)), IMG_HEIGHT, IMG_WIDTH);
+        uint32_t label_id;
+        if (this->GetAsAF(img, label_id))
+        {
+            label = this->GetClassName(label_id);
+        }
+    }
+
+    /**
+     * @brief Get the next image as af::array in the output format with its class id.
+     * The pixels are converted on host in one pass straight into the layout of af::array, then uploaded once
+     * @param img
+     * @param label_id
+     * @return bool false when the loader was stopped
+     */
+    bool GetAsAF(af::array &img, uint32_t &label_id){
+        return this->ImageAsAF(img, label_id, [this](const uint8_t *_source, void *_destination)
+                               { this->converter(_source, _destination, this->config.width, this->config.height, this->config.normalization); });
+    }
+
+    /**
+     * @brief Get the next whole batch as one af::array in the output format with its class names
+     * @param batch
+     * @param _labels N class names, in the same order as the images
+     */
+    void GetBatchAsAF(af::array &batch, lantern::utility::Vector<std::string> &_labels){
+        lantern::utility::Vector<uint32_t> label_ids;
+        if (this->GetBatchAsAF(batch, label_ids))
+        {
+            _labels.clean();
+            for (auto label_id : label_ids)
+            {
+                _labels.push_back(this->GetClassName(label_id));
+            }
+        }
+    }
 
-        img = af::join(2, R, G, B);
-        img = af::reorder(img, 1, 0, 2);
-        img = img.as(f32) / 255;
+    /**
+     * @brief Get the next whole batch as one af::array in the output format with its class ids, the batch is
+     * the last dimension (default f32 height x width x channels x N).
+     * Every image is converted straight into a pinned host buffer, then the batch is uploaded with a single
+     * transfer. When batch already has the same shape and type its memory is reused through write(), so keep
+     * passing the same array every step and do not hold other references to it
+     * @param batch
+     * @param _label_ids N class ids, in the same order as the images
+     * @return bool false when the loader was stopped
+     */
+    bool GetBatchAsAF(af::array &batch, lantern::utility::Vector<uint32_t> &_label_ids){
+        return this->BatchAsAF(batch, _label_ids, [this](const uint8_t *_source, void *_destination)
+                               { this->converter(_source, _destination, this->config.width, this->config.height, this->config.normalization); });
+    }
 
-        auto& label_data = this->label_cache[this->active_dataset];
-        label = label_data.at(this->head > 0? this->head - 1 : TOTAL_IMAGES - 1);
+    /**
+     * @brief Set element type and layout of GetAsAF and GetBatchAsAF, must be called before Run()
+     * @param _type
+     * @param _layout
+     */
+    void SetOutputFormat(const lantern::data::PixelType &_type, const lantern::data::TensorLayout &_layout)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.output_type = _type;
+        _config.output_layout = _layout;
+        this->SetConfig(_config);
     }
 
     template <typename T>
@@ -241,7 +2178,137 @@ public:
     template <typename T>
     auto GetCSVLabelAtCol(const uint32_t& _col){
         this->CheckDatasetValid();
-        return this->labels[this->active_dataset].Col<T>(_row);
+        return this->labels[this->active_dataset].Col<T>(_col);
+    }
+
+};
+
+/**
+ * @brief Compile time form of the loader, the shape is fixed by template parameters
+ * and TOTAL_IMAGES is the total images kept in memory, so the queue depth follow the batch size
+ * @tparam TOTAL_IMAGES
+ * @tparam IMG_WIDTH
+ * @tparam IMG_HEIGHT
+ * @tparam Format lantern::data::PixelFormat, total channels decoded and element type and layout of GetAsAF
+ */
+template <uint32_t TOTAL_IMAGES, uint32_t IMG_WIDTH, uint32_t IMG_HEIGHT, typename Format = lantern::data::PixelRGB>
+class LanternImageLoader : public LanternDynamicImageLoader
+{
+private:
+    static LanternImageLoaderConfig MakeConfig()
+    {
+        return LanternImageLoaderConfig{
+            .queue_depth = std::max<uint32_t>(2, TOTAL_IMAGES),
+            .batch_size = 1,
+            .width = IMG_WIDTH,
+            .height = IMG_HEIGHT,
+            .channels = Format::channels,
+            .output_type = Format::type,
+            .output_layout = Format::layout,
+        };
+    }
+
+    /**
+     * @brief True while the shape and output format still match the template parameters, the
+     * setters inherited from LanternDynamicImageLoader can change them at runtime
+     * @return bool
+     */
+    bool IsFormatConfig() const
+    {
+        return this->config.width == IMG_WIDTH && this->config.height == IMG_HEIGHT && this->config.channels == Format::channels &&
+               this->config.output_type == Format::type && this->config.output_layout == Format::layout;
+    }
+
+    static void Convert(const uint8_t *_source, void *_destination, const lantern::data::Normalization &_normalization)
+    {
+        lantern::data::ConvertImage<Format>(_source, static_cast<typename Format::value_type *>(_destination), IMG_WIDTH, IMG_HEIGHT, _normalization);
+    }
+
+public:
+    static_assert(IMG_WIDTH > 0 && IMG_HEIGHT > 0, "LanternImageLoader, image shape must be greater than zero");
+    static_assert(TOTAL_IMAGES > 0, "LanternImageLoader, TOTAL_IMAGES must be greater than zero");
+
+    using pixel_format = Format;
+    static constexpr uint32_t total_channels = Format::channels;
+    static constexpr size_t total_image_size = (size_t)IMG_WIDTH * IMG_HEIGHT * total_channels;
+    static constexpr size_t total_output_size = Format::ImageSize(IMG_WIDTH, IMG_HEIGHT) * sizeof(typename Format::value_type);
+
+    LanternImageLoader()
+        : LanternDynamicImageLoader(MakeConfig())
+    {
+    }
+
+    /**
+     * @brief Set total images in one ring slot, the queue depth is recomputed so
+     * the loader still keep TOTAL_IMAGES images in memory
+     * @param _batch_size
+     */
+    void SetBatchSize(const uint32_t &_batch_size)
+    {
+        LanternImageLoaderConfig _config = this->config;
+        _config.batch_size = _batch_size;
+        _config.queue_depth = std::max<uint32_t>(2, TOTAL_IMAGES / std::max<uint32_t>(1, _batch_size));
+        this->SetConfig(_config);
+    }
+
+    void GetAsAF(af::array &img)
+    {
+        uint32_t label_id;
+        this->GetAsAF(img, label_id);
+    }
+
+    void GetAsAF(af::array &img, std::string &label)
+    {
+        uint32_t label_id;
+        if (this->GetAsAF(img, label_id))
+        {
+            label = this->GetClassName(label_id);
+        }
+    }
+
+    /**
+     * @brief Same as LanternDynamicImageLoader::GetAsAF, the conversion call ConvertImage<Format> with the
+     * template shape directly instead of the runtime converter
+     * @param img
+     * @param label_id
+     * @return bool false when the loader was stopped
+     */
+    bool GetAsAF(af::array &img, uint32_t &label_id)
+    {
+        if (!this->IsFormatConfig())
+        {
+            return LanternDynamicImageLoader::GetAsAF(img, label_id);
+        }
+        return this->ImageAsAF(img, label_id, [this](const uint8_t *_source, void *_destination)
+                               { Convert(_source, _destination, this->config.normalization); });
+    }
+
+    void GetBatchAsAF(af::array &batch, lantern::utility::Vector<std::string> &_labels)
+    {
+        lantern::utility::Vector<uint32_t> label_ids;
+        if (this->GetBatchAsAF(batch, label_ids))
+        {
+            _labels.clean();
+            for (auto label_id : label_ids)
+            {
+                _labels.push_back(this->GetClassName(label_id));
+            }
+        }
     }
 
+    /**
+     * @brief Same as LanternDynamicImageLoader::GetBatchAsAF, every image is converted with ConvertImage<Format> directly
+     * @param batch
+     * @param _label_ids
+     * @return bool false when the loader was stopped
+     */
+    bool GetBatchAsAF(af::array &batch, lantern::utility::Vector<uint32_t> &_label_ids)
+    {
+        if (!this->IsFormatConfig())
+        {
+            return LanternDynamicImageLoader::GetBatchAsAF(batch, _label_ids);
+        }
+        return this->BatchAsAF(batch, _label_ids, [this](const uint8_t *_source, void *_destination)
+                               { Convert(_source, _destination, this->config.normalization); });
+    }
 };
\ No newline at end of file
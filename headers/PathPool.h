@@ -0,0 +1,203 @@
+#pragma once
+#include "../pch.h"
+#include "Vector.h"
+
+namespace lantern {
+
+    namespace utility {
+
+        /**
+         * @brief How PathPool keep the file names inside its arena
+         * @ingroup LanternContainer
+         */
+        enum class PathLayout : uint8_t {
+            Plain,      // every name stored whole, one offset per file
+            FrontCoded  // every name store only the suffix not shared with the name before, one offset per block
+        };
+
+        /**
+         * @brief Compact store of many file paths. Every directory is kept once, the file names are
+         * stored back to back inside one contiguous char arena and the full path is assembled on demand.
+         *
+         * Files of one directory are appended together, so the directory of a file is found with a
+         * binary search over the directory runs and costs nothing per file. With the plain layout a
+         * file cost 4 bytes of offset plus its name, with the front coded layout the names are split
+         * in blocks, the first name of a block is whole and the next ones only keep the length of the
+         * prefix shared with the name before and the rest, so memory follow the unique bytes of the names.
+         * @ingroup LanternContainer
+         */
+        class PathPool {
+        private:
+            static constexpr uint32_t block_size = 16;
+
+            PathLayout layout = PathLayout::Plain;
+            Vector<char> names;
+            Vector<uint32_t> offsets;         // plain: begin of every name plus the end, front coded: begin of every block
+            Vector<std::string> directories;  // directory prefix, with its trailing separator
+            Vector<uint32_t> directory_first; // index of the first file of every directory run
+            std::string last_name;            // name before the next one, used by the front coding
+            uint32_t total = 0;
+
+            void AppendBytes(const char *bytes, const size_t &size) {
+                if ((uint64_t)this->names.size() + size > std::numeric_limits<uint32_t>::max()) {
+                    throw std::runtime_error("Error PathPool, file names are bigger than 4 GB");
+                }
+                uint32_t used = this->names.size();
+                if (this->names.getCapacity() < used + size) {
+                    uint64_t grown = std::max<uint64_t>((uint64_t)used + size, (uint64_t)this->names.getCapacity() * 3 / 2);
+                    this->names.resizeCapacity(static_cast<uint32_t>(std::min<uint64_t>(grown, std::numeric_limits<uint32_t>::max())));
+                }
+                std::memcpy(this->names.getData() + used, bytes, size);
+                this->names.explicitTotalItem(used + static_cast<uint32_t>(size));
+            }
+
+            void AppendVarint(uint32_t value) {
+                char bytes[5];
+                size_t size = 0;
+                do {
+                    bytes[size++] = static_cast<char>((value & 0x7f) | (value >= 0x80 ? 0x80 : 0));
+                    value >>= 7;
+                } while (value > 0);
+                this->AppendBytes(bytes, size);
+            }
+
+            static uint32_t ReadVarint(const char *&cursor) {
+                uint32_t value = 0;
+                for (uint32_t shift = 0;; shift += 7) {
+                    uint8_t byte = static_cast<uint8_t>(*cursor++);
+                    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+                    if ((byte & 0x80) == 0) {
+                        return value;
+                    }
+                }
+            }
+
+            void AppendName(const std::string_view &name) {
+                if (this->layout == PathLayout::Plain) {
+                    if (this->offsets.empty()) {
+                        this->offsets.push_back(0);
+                    }
+                    this->AppendBytes(name.data(), name.size());
+                    this->offsets.push_back(this->names.size());
+                    return;
+                }
+                uint32_t prefix = 0;
+                if (this->total % block_size == 0) {
+                    this->offsets.push_back(this->names.size());
+                }
+                else {
+                    size_t limit = std::min(name.size(), this->last_name.size());
+                    while (prefix < limit && name[prefix] == this->last_name[prefix]) {
+                        prefix++;
+                    }
+                }
+                this->AppendVarint(prefix);
+                this->AppendVarint(static_cast<uint32_t>(name.size() - prefix));
+                this->AppendBytes(name.data() + prefix, name.size() - prefix);
+                this->last_name.assign(name);
+            }
+
+            uint32_t DirectoryOf(const uint32_t &index) const {
+                const uint32_t *first = this->directory_first.getData();
+                return static_cast<uint32_t>(std::upper_bound(first, first + this->directory_first.size(), index) - first) - 1;
+            }
+
+        public:
+            PathPool() = default;
+            explicit PathPool(const PathLayout &_layout) : layout(_layout) {}
+
+            PathPool(PathPool &&) = default;
+            PathPool &operator=(PathPool &&) = default;
+
+            /**
+             * @brief Add a file path, the directory is shared with the file before when it is the same
+             * @param path
+             */
+            void Push(const std::string_view &path) {
+                size_t split = path.find_last_of("/\\");
+                split = split == std::string_view::npos ? 0 : split + 1;
+                std::string_view directory = path.substr(0, split);
+                if (this->directories.empty() || this->directories.back() != directory) {
+                    this->directories.push_back(std::string(directory));
+                    this->directory_first.push_back(this->total);
+                }
+                this->AppendName(path.substr(split));
+                this->total++;
+            }
+
+            /**
+             * @brief Assemble the full path of the file into path, path keep its capacity across calls
+             * @param index
+             * @param path
+             */
+            void Get(const uint32_t &index, std::string &path) const {
+                path.assign(this->directories.getData()[this->DirectoryOf(index)]);
+                const char *bytes = this->names.getData();
+                if (this->layout == PathLayout::Plain) {
+                    path.append(bytes + this->offsets.getData()[index], this->offsets.getData()[index + 1] - this->offsets.getData()[index]);
+                    return;
+                }
+                // decode the block from its first name up to the file, every name rebuild on the one before
+                size_t base = path.size();
+                const char *cursor = bytes + this->offsets.getData()[index / block_size];
+                for (uint32_t i = index - index % block_size; i <= index; i++) {
+                    uint32_t prefix = ReadVarint(cursor);
+                    uint32_t suffix = ReadVarint(cursor);
+                    path.resize(base + prefix);
+                    path.append(cursor, suffix);
+                    cursor += suffix;
+                }
+            }
+
+            std::string Get(const uint32_t &index) const {
+                std::string path;
+                this->Get(index, path);
+                return path;
+            }
+
+            /**
+             * @brief Change the layout, the paths already added are stored again with the new layout
+             * @param _layout
+             */
+            void SetLayout(const PathLayout &_layout) {
+                if (_layout == this->layout) {
+                    return;
+                }
+                PathPool pool(_layout);
+                std::string path;
+                for (uint32_t i = 0; i < this->total; i++) {
+                    this->Get(i, path);
+                    pool.Push(path);
+                }
+                *this = std::move(pool);
+            }
+
+            PathLayout GetLayout() const {
+                return this->layout;
+            }
+
+            uint32_t Size() const {
+                return this->total;
+            }
+
+            bool Empty() const {
+                return this->total == 0;
+            }
+
+            /**
+             * @brief Bytes held by the names, offsets and directories
+             * @return size_t
+             */
+            size_t MemoryUsage() const {
+                size_t bytes = (size_t)this->names.getCapacity() + (size_t)this->offsets.getCapacity() * sizeof(uint32_t) +
+                               (size_t)this->directory_first.getCapacity() * sizeof(uint32_t);
+                for (uint32_t i = 0; i < this->directories.size(); i++) {
+                    bytes += sizeof(std::string) + this->directories.getData()[i].capacity();
+                }
+                return bytes;
+            }
+        };
+
+    }
+
+}
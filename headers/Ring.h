@@ -0,0 +1,270 @@
+#pragma once
+#include "../pch.h"
+#include <memory>
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace lantern {
+
+    namespace utility {
+
+        /**
+         * @brief Size used to pad the shared indices so producer and consumer do not share a cache line
+         * @ingroup LanternContainer
+         */
+        inline constexpr size_t cache_line_size = 64;
+
+        /**
+         * @brief Hint the CPU that we are in spin loop
+         * @ingroup LanternContainer
+         */
+        inline void CpuRelax() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#else
+            std::this_thread::yield();
+#endif
+        }
+
+        /**
+         * @brief Lock-free bounded ring of slot positions (Vyukov sequence ring)
+         *
+         * The ring only hand out positions, the slot data lives in the owner of the ring.
+         * Producers reserve a position, fill the slot and publish it, consumers reserve a
+         * published position, read the slot and release it back to producers. Every slot
+         * carry its own sequence number so producers and consumers may finish out of order.
+         * With single producer the write index is advanced with plain store (SPSC), otherwise
+         * with CAS (MPMC). Blocking is only a fallback after spinning, using atomic wait
+         * which is futex on linux.
+         * @ingroup LanternContainer
+         */
+        class SlotRing {
+        private:
+            struct alignas(cache_line_size) Slot {
+                std::atomic<uint64_t> sequence = 0;
+            };
+
+            std::unique_ptr<Slot[]> slots;
+            uint32_t capacity = 0;
+            bool single_producer = true;
+
+            alignas(cache_line_size) std::atomic<uint64_t> write_pos = 0;
+            alignas(cache_line_size) std::atomic<uint64_t> read_pos = 0;
+            alignas(cache_line_size) std::atomic<uint32_t> events = 0;
+            std::atomic<uint32_t> waiters = 0;
+            std::atomic<bool> stopped = false;
+
+            static constexpr uint32_t spin_limit = 128;
+
+            /**
+             * @brief Spin on the try operation, then fallback to atomic wait
+             * @tparam TryFn
+             * @param try_fn
+             * @return bool false when the ring was stopped
+             */
+            template <typename TryFn>
+            bool Wait(TryFn &&try_fn) {
+                for (uint32_t i = 0; i < spin_limit; i++) {
+                    if (this->stopped.load(std::memory_order_relaxed)) {
+                        return false;
+                    }
+                    if (try_fn()) {
+                        return true;
+                    }
+                    CpuRelax();
+                }
+
+                while (true) {
+                    this->waiters.fetch_add(1, std::memory_order_seq_cst);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    uint32_t event = this->events.load(std::memory_order_seq_cst);
+                    if (this->stopped.load(std::memory_order_seq_cst)) {
+                        this->waiters.fetch_sub(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    if (try_fn()) {
+                        this->waiters.fetch_sub(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                    this->events.wait(event, std::memory_order_seq_cst);
+                    this->waiters.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+
+            /**
+             * @brief Wake blocked waiters, cost only one load when nobody is blocked
+             */
+            void Signal() {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (this->waiters.load(std::memory_order_relaxed) > 0) {
+                    this->events.fetch_add(1, std::memory_order_seq_cst);
+                    this->events.notify_all();
+                }
+            }
+
+        public:
+            SlotRing() = default;
+            SlotRing(const SlotRing &) = delete;
+            SlotRing &operator=(const SlotRing &) = delete;
+
+            /**
+             * @brief Reset the ring, must not be called while producer or consumer are running
+             * @param _capacity
+             * @param _single_producer
+             */
+            void Reset(const uint32_t &_capacity, const bool &_single_producer) {
+                if (_capacity < 2) {
+                    throw std::runtime_error("Error SlotRing, capacity must be at least 2");
+                }
+                if (_capacity != this->capacity) {
+                    this->slots = std::make_unique<Slot[]>(_capacity);
+                    this->capacity = _capacity;
+                }
+                for (uint32_t i = 0; i < this->capacity; i++) {
+                    this->slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+                this->single_producer = _single_producer;
+                this->write_pos.store(0, std::memory_order_relaxed);
+                this->read_pos.store(0, std::memory_order_relaxed);
+                this->stopped.store(false, std::memory_order_release);
+            }
+
+            /**
+             * @brief Get slot index of a position
+             * @param pos
+             * @return uint32_t
+             */
+            uint32_t SlotOf(const uint64_t &pos) const {
+                return static_cast<uint32_t>(pos % this->capacity);
+            }
+
+            uint32_t getCapacity() const {
+                return this->capacity;
+            }
+
+            /**
+             * @brief Check if any slot was reserved for reading but not released yet
+             * @return bool
+             */
+            bool HasPendingReads() const {
+                uint64_t read = this->read_pos.load(std::memory_order_acquire);
+                for (uint32_t i = 0; i < this->capacity; i++) {
+                    uint64_t sequence = this->slots[i].sequence.load(std::memory_order_acquire);
+                    if (sequence > 0 && this->SlotOf(sequence - 1) == i && sequence - 1 < read) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            /**
+             * @brief Try reserve a free slot for writing
+             * @param pos
+             * @return bool false when the ring was full
+             */
+            bool TryReserveWrite(uint64_t &pos) {
+                pos = this->write_pos.load(std::memory_order_relaxed);
+                while (true) {
+                    uint64_t sequence = this->slots[this->SlotOf(pos)].sequence.load(std::memory_order_acquire);
+                    int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+                    if (diff == 0) {
+                        if (this->single_producer) {
+                            this->write_pos.store(pos + 1, std::memory_order_relaxed);
+                            return true;
+                        }
+                        if (this->write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = this->write_pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            /**
+             * @brief Reserve a free slot for writing, block when the ring was full
+             * @param pos
+             * @return bool false when the ring was stopped
+             */
+            bool ReserveWrite(uint64_t &pos) {
+                return this->Wait([&]() { return this->TryReserveWrite(pos); });
+            }
+
+            /**
+             * @brief Block until the next write position is free, without reserving it
+             * @return bool false when the ring was stopped
+             */
+            bool WaitWritable() {
+                return this->Wait([&]() {
+                    uint64_t pos = this->write_pos.load(std::memory_order_relaxed);
+                    return this->slots[this->SlotOf(pos)].sequence.load(std::memory_order_acquire) == pos;
+                });
+            }
+
+            /**
+             * @brief Publish written slot to consumers
+             * @param pos
+             */
+            void PublishWrite(const uint64_t &pos) {
+                this->slots[this->SlotOf(pos)].sequence.store(pos + 1, std::memory_order_release);
+                this->Signal();
+            }
+
+            /**
+             * @brief Try reserve a published slot for reading
+             * @param pos
+             * @return bool false when the ring was empty
+             */
+            bool TryReserveRead(uint64_t &pos) {
+                pos = this->read_pos.load(std::memory_order_relaxed);
+                while (true) {
+                    uint64_t sequence = this->slots[this->SlotOf(pos)].sequence.load(std::memory_order_acquire);
+                    int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos + 1);
+                    if (diff == 0) {
+                        if (this->read_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = this->read_pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            /**
+             * @brief Reserve a published slot for reading, block when the ring was empty
+             * @param pos
+             * @return bool false when the ring was stopped
+             */
+            bool ReserveRead(uint64_t &pos) {
+                return this->Wait([&]() { return this->TryReserveRead(pos); });
+            }
+
+            /**
+             * @brief Give the slot back to producers
+             * @param pos
+             */
+            void ReleaseRead(const uint64_t &pos) {
+                this->slots[this->SlotOf(pos)].sequence.store(pos + this->capacity, std::memory_order_release);
+                this->Signal();
+            }
+
+            /**
+             * @brief Stop the ring and wake every blocked producer and consumer
+             */
+            void Stop() {
+                this->stopped.store(true, std::memory_order_seq_cst);
+                this->events.fetch_add(1, std::memory_order_seq_cst);
+                this->events.notify_all();
+            }
+        };
+
+    }
+
+}
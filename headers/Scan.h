@@ -0,0 +1,625 @@
+#pragma once
+#include "../pch.h"
+#include "Vector.h"
+#include "File.h"
+#include <condition_variable>
+#include <unordered_set>
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Every image found under a dataset root, with the class, size and modification time of the
+ * files and the modification time of every directory listed, so a saved scan can be checked cheaply.
+ *
+ * Layout of a manifest file: header, root path, extension filter, directory table (i64 mtime + u32 length + bytes per
+ * directory), class table (u32 length + bytes per class), class size column, then the file columns
+ * directory index, class id, name offset (u32 each, offsets have one more entry), size (u64), mtime (i64)
+ * and the file names back to back.
+ * @ingroup LanternFile
+ */
+struct ScanManifest
+{
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t directory_count;
+        uint32_t class_count;
+        uint32_t file_count;
+        uint64_t root_length;
+        uint64_t extensions_length;
+        uint64_t names_size;
+    };
+
+    static constexpr uint32_t magic = 0x324e4d4cu; // "LMN2"
+
+    std::string root;
+    std::string extensions; // image extensions accepted by the scan, see DatasetScanner::ExtensionKey()
+    lantern::utility::Vector<std::string> directories; // every directory listed with its trailing separator, the root first
+    lantern::utility::Vector<int64_t> directory_mtimes;
+    lantern::utility::Vector<std::string> class_names;
+    lantern::utility::Vector<uint32_t> class_sizes;      // images per class, the files are grouped by class
+    lantern::utility::Vector<uint32_t> file_directories; // directory index of every file
+    lantern::utility::Vector<uint32_t> class_ids;
+    lantern::utility::Vector<uint32_t> name_offsets;     // begin of every name inside names plus the end
+    lantern::utility::Vector<uint64_t> file_sizes;
+    lantern::utility::Vector<int64_t> file_mtimes;
+    std::string names;
+
+    /**
+     * @brief Get modification time of a file or directory, in the unit of the platform clock
+     * @param _path
+     * @param mtime
+     * @param size
+     * @return bool false when the path cannot be stat
+     */
+    static bool Stat(const char *_path, int64_t &mtime, uint64_t *size = nullptr)
+    {
+#if defined(__linux__)
+        struct stat info;
+        if (::stat(_path, &info) != 0)
+        {
+            return false;
+        }
+        mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+        if (size != nullptr)
+        {
+            *size = static_cast<uint64_t>(info.st_size);
+        }
+        return true;
+#else
+        std::error_code error;
+        auto time = std::filesystem::last_write_time(_path, error);
+        if (error)
+        {
+            return false;
+        }
+        mtime = static_cast<int64_t>(time.time_since_epoch().count());
+        if (size != nullptr)
+        {
+            *size = std::filesystem::is_regular_file(_path, error) ? std::filesystem::file_size(_path, error) : 0;
+        }
+        return !error;
+#endif
+    }
+
+    uint32_t Size() const
+    {
+        return this->file_directories.size();
+    }
+
+    std::string_view NameOf(const uint32_t &_index) const
+    {
+        uint32_t begin = this->name_offsets.getData()[_index];
+        return std::string_view(this->names).substr(begin, this->name_offsets.getData()[_index + 1] - begin);
+    }
+
+    /**
+     * @brief Write the manifest, it is written to temporary file then renamed so a reader never see a partial manifest
+     * @param _path
+     */
+    void Save(const std::filesystem::path &_path) const
+    {
+        std::filesystem::path temporary = _path;
+        temporary += ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                throw std::runtime_error(std::format("Error ScanManifest, failed to create file \"{}\"", temporary.string()));
+            }
+            auto write = [&](const void *_data, const size_t &_size)
+            {
+                file.write(static_cast<const char *>(_data), _size);
+            };
+            auto write_string = [&](const std::string &_value)
+            {
+                uint32_t length = static_cast<uint32_t>(_value.size());
+                write(&length, sizeof(length));
+                write(_value.data(), length);
+            };
+            Header header{magic, this->directories.size(), this->class_names.size(), this->Size(), this->root.size(), this->extensions.size(), this->names.size()};
+            write(&header, sizeof(header));
+            write(this->root.data(), this->root.size());
+            write(this->extensions.data(), this->extensions.size());
+            for (uint32_t d = 0; d < this->directories.size(); d++)
+            {
+                write(&this->directory_mtimes.getData()[d], sizeof(int64_t));
+                write_string(this->directories.getData()[d]);
+            }
+            for (uint32_t c = 0; c < this->class_names.size(); c++)
+            {
+                write_string(this->class_names.getData()[c]);
+            }
+            write(this->class_sizes.getData(), (size_t)header.class_count * sizeof(uint32_t));
+            write(this->file_directories.getData(), (size_t)header.file_count * sizeof(uint32_t));
+            write(this->class_ids.getData(), (size_t)header.file_count * sizeof(uint32_t));
+            write(this->name_offsets.getData(), ((size_t)header.file_count + 1) * sizeof(uint32_t));
+            write(this->file_sizes.getData(), (size_t)header.file_count * sizeof(uint64_t));
+            write(this->file_mtimes.getData(), (size_t)header.file_count * sizeof(int64_t));
+            write(this->names.data(), this->names.size());
+            if (!file)
+            {
+                file.close();
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                throw std::runtime_error(std::format("Error ScanManifest, failed to write file \"{}\"", temporary.string()));
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, _path, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            throw std::runtime_error(std::format("Error ScanManifest, failed to write file \"{}\"", _path.string()));
+        }
+    }
+
+    /**
+     * @brief Read the manifest saved for the root, the manifest is only used while every directory
+     * listed by the scan keep its modification time, an image added, removed or renamed change the
+     * modification time of its directory
+     * @param _path
+     * @param _root root of the scan, see DatasetScanner::RootOf()
+     * @param _extensions extension filter of the scan, see DatasetScanner::ExtensionKey()
+     * @return bool false when the manifest is missing, broken, of another root or extension filter, or out of date
+     */
+    bool Load(const std::filesystem::path &_path, const std::string &_root, const std::string &_extensions)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(_path, error))
+        {
+            return false;
+        }
+        MappedFile file;
+        try
+        {
+            file.Open(_path);
+        }
+        catch (const std::runtime_error &)
+        {
+            return false;
+        }
+        const uint8_t *cursor = file.GetData(), *end = file.GetData() + file.GetSize();
+        auto take = [&](const size_t &_size) -> const uint8_t *
+        {
+            if (cursor == nullptr || (size_t)(end - cursor) < _size)
+            {
+                cursor = nullptr;
+                return nullptr;
+            }
+            const uint8_t *data = cursor;
+            cursor += _size;
+            return data;
+        };
+        auto read_string = [&](std::string &_value)
+        {
+            uint32_t length = 0;
+            const uint8_t *data = take(sizeof(length));
+            if (data != nullptr)
+            {
+                std::memcpy(&length, data, sizeof(length));
+                data = take(length);
+            }
+            if (data != nullptr)
+            {
+                _value.assign(reinterpret_cast<const char *>(data), length);
+            }
+        };
+        auto read_column = [&]<typename T>(lantern::utility::Vector<T> &_column, const uint32_t &_count)
+        {
+            const uint8_t *data = take((size_t)_count * sizeof(T));
+            _column = lantern::utility::Vector<T>(std::max<uint32_t>(_count, 1));
+            if (data != nullptr)
+            {
+                std::memcpy(_column.getData(), data, (size_t)_count * sizeof(T));
+                _column.explicitTotalItem(_count);
+            }
+        };
+
+        Header header;
+        const uint8_t *data = take(sizeof(header));
+        if (data == nullptr)
+        {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        data = take(header.root_length);
+        if (header.magic != magic || data == nullptr || std::string_view(reinterpret_cast<const char *>(data), header.root_length) != _root)
+        {
+            return false;
+        }
+        data = take(header.extensions_length);
+        if (data == nullptr || std::string_view(reinterpret_cast<const char *>(data), header.extensions_length) != _extensions)
+        {
+            return false;
+        }
+
+        // only the directories are checked, so a manifest of millions of files is validated with a few stat
+        ScanManifest manifest;
+        manifest.root = _root;
+        manifest.extensions = _extensions;
+        for (uint32_t d = 0; d < header.directory_count && cursor != nullptr; d++)
+        {
+            int64_t saved = 0, current = 0;
+            data = take(sizeof(saved));
+            if (data == nullptr)
+            {
+                return false;
+            }
+            std::memcpy(&saved, data, sizeof(saved));
+            std::string directory;
+            read_string(directory);
+            if (cursor == nullptr || !Stat(directory.c_str(), current) || current != saved)
+            {
+                return false;
+            }
+            manifest.directories.push_back(std::move(directory));
+            manifest.directory_mtimes.push_back(saved);
+        }
+        for (uint32_t c = 0; c < header.class_count && cursor != nullptr; c++)
+        {
+            std::string name;
+            read_string(name);
+            manifest.class_names.push_back(std::move(name));
+        }
+        read_column(manifest.class_sizes, header.class_count);
+        read_column(manifest.file_directories, header.file_count);
+        read_column(manifest.class_ids, header.file_count);
+        read_column(manifest.name_offsets, header.file_count + 1);
+        read_column(manifest.file_sizes, header.file_count);
+        read_column(manifest.file_mtimes, header.file_count);
+        data = take(header.names_size);
+        if (data == nullptr || manifest.name_offsets.getData()[header.file_count] != header.names_size)
+        {
+            return false;
+        }
+        manifest.names.assign(reinterpret_cast<const char *>(data), header.names_size);
+        for (uint32_t i = 0; i < header.file_count; i++)
+        {
+            if (manifest.file_directories.getData()[i] >= header.directory_count || manifest.class_ids.getData()[i] >= header.class_count ||
+                manifest.name_offsets.getData()[i] > manifest.name_offsets.getData()[i + 1])
+            {
+                return false;
+            }
+        }
+        *this = std::move(manifest);
+        return true;
+    }
+};
+
+/**
+ * @brief Parallel recursive scanner of a dataset tree. Every subdirectory of the root is one class,
+ * its images are searched recursively. Every directory is one task taken by the next free thread, so
+ * deep and wide trees on network storage are listed with many requests in flight. On Linux the
+ * directories are read with getdents64 in large batches and the entry type is taken from the listing,
+ * only images are stat for their size and modification time.
+ * @ingroup LanternFile
+ */
+class DatasetScanner
+{
+private:
+    struct Task
+    {
+        std::string directory;
+        uint32_t class_id;
+    };
+
+    struct Listing
+    {
+        std::string directory;
+        uint32_t class_id = 0;
+        int64_t mtime = 0;
+        std::string names;
+        std::vector<uint32_t> name_offsets;
+        std::vector<uint64_t> sizes;
+        std::vector<int64_t> mtimes;
+    };
+
+    lantern::utility::Vector<std::string> extensions;
+
+    /**
+     * @brief Check the extension of the file name without allocation
+     * @param _name
+     * @return bool
+     */
+    bool IsImageName(const std::string_view &_name) const
+    {
+        size_t dot = _name.find_last_of('.');
+        if (dot == std::string_view::npos || _name.size() - dot > 15)
+        {
+            return false;
+        }
+        char lower[16];
+        size_t length = _name.size() - dot;
+        for (size_t i = 0; i < length; i++)
+        {
+            lower[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(_name[dot + i])));
+        }
+        std::string_view extension(lower, length);
+        for (uint32_t i = 0; i < this->extensions.size(); i++)
+        {
+            if (extension == this->extensions.getData()[i])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief List one directory, the images go into listing and the subdirectory names into subdirectories
+     * @param listing
+     * @param subdirectories
+     * @param buffer scratch of the thread for the directory entries
+     * @return bool false when the directory cannot be read
+     */
+    bool List(Listing &listing, lantern::utility::Vector<std::string> &subdirectories, lantern::utility::Vector<uint8_t> &buffer) const
+    {
+        auto add_file = [&](const std::string_view &_name, const uint64_t &_size, const int64_t &_mtime)
+        {
+            listing.name_offsets.push_back(static_cast<uint32_t>(listing.names.size()));
+            listing.names.append(_name);
+            listing.sizes.push_back(_size);
+            listing.mtimes.push_back(_mtime);
+        };
+#if defined(__linux__)
+        int descriptor = ::open(listing.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct stat info;
+        if (descriptor < 0 || ::fstat(descriptor, &info) != 0)
+        {
+            if (descriptor >= 0)
+            {
+                ::close(descriptor);
+            }
+            return false;
+        }
+        listing.mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+        while (true)
+        {
+            long total = ::syscall(SYS_getdents64, descriptor, buffer.getData(), buffer.getCapacity());
+            if (total <= 0)
+            {
+                break;
+            }
+            for (long offset = 0; offset < total;)
+            {
+                const dirent64 *entry = reinterpret_cast<const dirent64 *>(buffer.getData() + offset);
+                offset += entry->d_reclen;
+                std::string_view name(entry->d_name);
+                if (name == "." || name == "..")
+                {
+                    continue;
+                }
+                unsigned char type = entry->d_type;
+                if (type == DT_UNKNOWN && ::fstatat(descriptor, entry->d_name, &info, AT_SYMLINK_NOFOLLOW) == 0)
+                {
+                    // some file systems do not fill the type, fall back to stat
+                    type = S_ISDIR(info.st_mode) ? DT_DIR : DT_REG;
+                }
+                if (type == DT_DIR)
+                {
+                    subdirectories.push_back(std::string(name));
+                }
+                else if ((type == DT_REG || type == DT_LNK) && this->IsImageName(name) &&
+                         ::fstatat(descriptor, entry->d_name, &info, 0) == 0 && S_ISREG(info.st_mode))
+                {
+                    add_file(name, static_cast<uint64_t>(info.st_size), static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec);
+                }
+            }
+        }
+        ::close(descriptor);
+        return true;
+#else
+        if (!ScanManifest::Stat(listing.directory.c_str(), listing.mtime))
+        {
+            return false;
+        }
+        std::error_code error;
+        for (auto &entry : std::filesystem::directory_iterator(listing.directory, error))
+        {
+            std::string name = entry.path().filename().string();
+            if (entry.is_directory(error) && !entry.is_symlink(error))
+            {
+                subdirectories.push_back(name);
+            }
+            else if (this->IsImageName(name) && entry.is_regular_file(error))
+            {
+                uint64_t size = entry.file_size(error);
+                auto time = entry.last_write_time(error);
+                add_file(name, size, static_cast<int64_t>(time.time_since_epoch().count()));
+            }
+        }
+        return !error;
+#endif
+    }
+
+public:
+    /**
+     * @brief Create scanner for the file extensions, lowercase with the dot
+     * @param _extensions
+     */
+    explicit DatasetScanner(const std::unordered_set<std::string> &_extensions)
+    {
+        for (auto &extension : _extensions)
+        {
+            this->extensions.push_back(extension);
+        }
+    }
+
+    /**
+     * @brief Get the extension filter as it is stored in the manifest, sorted and joined by ';' so the
+     * same set always give the same key
+     * @return std::string
+     */
+    std::string ExtensionKey() const
+    {
+        lantern::utility::Vector<std::string> sorted = this->extensions;
+        std::sort(sorted.getData(), sorted.getData() + sorted.size());
+        std::string key;
+        for (uint32_t i = 0; i < sorted.size(); i++)
+        {
+            key += sorted.getData()[i];
+            key += ';';
+        }
+        return key;
+    }
+
+    /**
+     * @brief Get the root as it is stored in the manifest, absolute and without trailing separator
+     * @param _root
+     * @return std::string
+     */
+    static std::string RootOf(const std::filesystem::path &_root)
+    {
+        std::filesystem::path root = std::filesystem::absolute(_root).lexically_normal();
+        if (!root.has_filename() && root.has_parent_path() && root != root.root_path())
+        {
+            root = root.parent_path();
+        }
+        return root.string();
+    }
+
+    /**
+     * @brief Scan the tree with several threads, the classes are the subdirectories of the root sorted
+     * by name, the directories and the images of a class are sorted by path so the result do not depend
+     * on the thread timing. Images directly under the root belong to no class, they are reported and skipped
+     * @param _root
+     * @param _total_threads
+     * @return ScanManifest
+     */
+    ScanManifest Scan(const std::filesystem::path &_root, const uint32_t &_total_threads) const
+    {
+        const char separator = static_cast<char>(std::filesystem::path::preferred_separator);
+        ScanManifest manifest;
+        manifest.root = RootOf(_root);
+        manifest.extensions = this->ExtensionKey();
+
+        Listing root_listing;
+        root_listing.directory = manifest.root + separator;
+        lantern::utility::Vector<std::string> class_names;
+        lantern::utility::Vector<uint8_t> buffer(1 << 16);
+        if (!this->List(root_listing, class_names, buffer))
+        {
+            throw std::runtime_error(std::format("Error DatasetScanner, cannot access folder path \"{}\" looks like deleted or moved", manifest.root));
+        }
+        if (!root_listing.sizes.empty())
+        {
+            std::println("Error DatasetScanner, {} images directly under \"{}\" have no class folder, skipped", root_listing.sizes.size(), manifest.root);
+        }
+        std::sort(class_names.getData(), class_names.getData() + class_names.size());
+
+        std::mutex mutex;
+        std::condition_variable ready;
+        lantern::utility::Vector<Task> tasks;
+        std::vector<Listing> listings;
+        uint32_t busy = 0;
+        for (uint32_t c = 0; c < class_names.size(); c++)
+        {
+            tasks.push_back(Task{root_listing.directory + class_names.getData()[c] + separator, c});
+        }
+
+        auto work = [&]()
+        {
+            lantern::utility::Vector<uint8_t> scratch(1 << 16);
+            lantern::utility::Vector<std::string> subdirectories;
+            while (true)
+            {
+                Listing listing;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&]()
+                               { return !tasks.empty() || busy == 0; });
+                    if (tasks.empty())
+                    {
+                        return;
+                    }
+                    listing.directory = std::move(tasks.back().directory);
+                    listing.class_id = tasks.back().class_id;
+                    tasks.pop_back();
+                    busy++;
+                }
+                subdirectories.clean();
+                bool listed = this->List(listing, subdirectories, scratch);
+                if (!listed)
+                {
+                    std::println("Error DatasetScanner, cannot read directory \"{}\", skipped", listing.directory);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (auto &name : subdirectories)
+                    {
+                        tasks.push_back(Task{listing.directory + name + separator, listing.class_id});
+                    }
+                    if (listed)
+                    {
+                        listings.push_back(std::move(listing));
+                    }
+                    busy--;
+                }
+                ready.notify_all();
+            }
+        };
+        lantern::utility::Vector<std::thread> workers;
+        for (uint32_t i = 1; i < std::max<uint32_t>(_total_threads, 1); i++)
+        {
+            workers.push_back(std::thread(work));
+        }
+        work();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        std::sort(listings.begin(), listings.end(), [](const Listing &a, const Listing &b)
+                  { return a.class_id != b.class_id ? a.class_id < b.class_id : a.directory < b.directory; });
+        manifest.directories.push_back(root_listing.directory);
+        manifest.directory_mtimes.push_back(root_listing.mtime);
+        for (auto &name : class_names)
+        {
+            manifest.class_names.push_back(name);
+            manifest.class_sizes.push_back(0);
+        }
+        manifest.name_offsets.push_back(0);
+        std::vector<uint32_t> order;
+        for (auto &listing : listings)
+        {
+            uint32_t directory = manifest.directories.size();
+            manifest.directories.push_back(listing.directory);
+            manifest.directory_mtimes.push_back(listing.mtime);
+            uint32_t total = static_cast<uint32_t>(listing.sizes.size());
+            listing.name_offsets.push_back(static_cast<uint32_t>(listing.names.size()));
+            auto name_of = [&](const uint32_t &i)
+            {
+                return std::string_view(listing.names).substr(listing.name_offsets[i], listing.name_offsets[i + 1] - listing.name_offsets[i]);
+            };
+            order.resize(total);
+            for (uint32_t i = 0; i < total; i++)
+            {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [&](const uint32_t &a, const uint32_t &b)
+                      { return name_of(a) < name_of(b); });
+            if ((uint64_t)manifest.Size() + total > std::numeric_limits<uint32_t>::max() ||
+                manifest.names.size() + listing.names.size() > std::numeric_limits<uint32_t>::max())
+            {
+                throw std::runtime_error("Error DatasetScanner, too many files under the root");
+            }
+            for (auto i : order)
+            {
+                manifest.names.append(name_of(i));
+                manifest.name_offsets.push_back(static_cast<uint32_t>(manifest.names.size()));
+                manifest.file_directories.push_back(directory);
+                manifest.class_ids.push_back(listing.class_id);
+                manifest.file_sizes.push_back(listing.sizes[i]);
+                manifest.file_mtimes.push_back(listing.mtimes[i]);
+            }
+            manifest.class_sizes.getData()[listing.class_id] += total;
+        }
+        return manifest;
+    }
+};
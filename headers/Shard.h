@@ -0,0 +1,297 @@
+#pragma once
+#include "../pch.h"
+#include "Vector.h"
+#include "File.h"
+
+/**
+ * @brief Header at the start of every shard file.
+ *
+ * Layout of a shard: header, class name table (u32 length + bytes per class), padding to
+ * page boundary, the pixel records with fixed stride, then the label id column (u32 per record).
+ * Every record is one image already resized to width x height x channels, HWC uint8.
+ * @ingroup LanternFile
+ */
+struct ShardHeader
+{
+    uint32_t magic;
+    uint32_t width, height, channels;
+    uint32_t record_count;
+    uint32_t class_count;
+    uint32_t names_size;
+    uint32_t reserved;
+    uint64_t record_stride;
+    uint64_t names_offset;
+    uint64_t records_offset;
+    uint64_t labels_offset;
+};
+
+inline constexpr uint32_t shard_magic = 0x3148534cu; // "LSH1"
+inline constexpr uint64_t shard_records_alignment = 4096;
+inline constexpr uint64_t shard_record_alignment = 64;
+
+/**
+ * @brief Position of one record inside a set of shards
+ * @ingroup LanternFile
+ */
+struct ShardRecord
+{
+    uint32_t shard;
+    uint32_t record;
+};
+
+/**
+ * @brief Write pre-resized images into one shard file, records are streamed to disk and
+ * the label column and header are written on Close()
+ * @ingroup LanternFile
+ */
+class ShardWriter
+{
+private:
+    std::ofstream file;
+    std::filesystem::path path;
+    ShardHeader header{};
+    lantern::utility::Vector<uint32_t> labels;
+    lantern::utility::Vector<uint8_t> padding;
+
+    void WriteZeros(const uint64_t &_size)
+    {
+        uint64_t remain = _size;
+        while (remain > 0)
+        {
+            uint64_t chunk = std::min<uint64_t>(remain, this->padding.size());
+            this->file.write(reinterpret_cast<const char *>(this->padding.getData()), chunk);
+            remain -= chunk;
+        }
+    }
+
+public:
+    ShardWriter() {}
+    ShardWriter(const ShardWriter &) = delete;
+    ShardWriter &operator=(const ShardWriter &) = delete;
+
+    ~ShardWriter()
+    {
+        if (this->file.is_open())
+        {
+            this->file.close();
+        }
+    }
+
+    /**
+     * @brief Create the shard file
+     * @param _path
+     * @param _width
+     * @param _height
+     * @param _channels
+     * @param _class_names name of every label id
+     */
+    void Open(const std::filesystem::path &_path, const uint32_t &_width, const uint32_t &_height, const uint32_t &_channels,
+              lantern::utility::Vector<std::string> &_class_names)
+    {
+        this->file.open(_path, std::ios::binary | std::ios::trunc);
+        if (!this->file.is_open())
+        {
+            throw std::runtime_error(std::format("Error ShardWriter, failed to create file \"{}\"", _path.string()));
+        }
+        this->path = _path;
+        this->labels.clean();
+        this->padding = lantern::utility::Vector<uint8_t>(shard_records_alignment, 0);
+
+        uint64_t names_size = 0;
+        for (auto &name : _class_names)
+        {
+            names_size += sizeof(uint32_t) + name.size();
+        }
+        uint64_t record_size = (uint64_t)_width * _height * _channels;
+        this->header = ShardHeader{};
+        this->header.magic = shard_magic;
+        this->header.width = _width;
+        this->header.height = _height;
+        this->header.channels = _channels;
+        this->header.class_count = _class_names.size();
+        this->header.names_size = static_cast<uint32_t>(names_size);
+        this->header.record_stride = (record_size + shard_record_alignment - 1) / shard_record_alignment * shard_record_alignment;
+        this->header.names_offset = sizeof(ShardHeader);
+        this->header.records_offset = (sizeof(ShardHeader) + names_size + shard_records_alignment - 1) / shard_records_alignment * shard_records_alignment;
+
+        // header is written again on Close() with the final counts
+        this->file.write(reinterpret_cast<const char *>(&this->header), sizeof(ShardHeader));
+        for (auto &name : _class_names)
+        {
+            uint32_t length = static_cast<uint32_t>(name.size());
+            this->file.write(reinterpret_cast<const char *>(&length), sizeof(length));
+            this->file.write(name.data(), length);
+        }
+        this->WriteZeros(this->header.records_offset - sizeof(ShardHeader) - names_size);
+    }
+
+    /**
+     * @brief Append one resized image
+     * @param _label_id
+     * @param _pixels width x height x channels bytes
+     */
+    void Append(const uint32_t &_label_id, const uint8_t *_pixels)
+    {
+        if (_label_id >= this->header.class_count)
+        {
+            throw std::runtime_error(std::format("Error ShardWriter, label id {} out of bound", _label_id));
+        }
+        uint64_t record_size = (uint64_t)this->header.width * this->header.height * this->header.channels;
+        this->file.write(reinterpret_cast<const char *>(_pixels), record_size);
+        this->WriteZeros(this->header.record_stride - record_size);
+        this->labels.push_back(_label_id);
+    }
+
+    uint32_t Size() const
+    {
+        return this->labels.size();
+    }
+
+    /**
+     * @brief Write the label column and the final header, then close the file
+     */
+    void Close()
+    {
+        this->header.record_count = this->labels.size();
+        this->header.labels_offset = this->header.records_offset + (uint64_t)this->header.record_count * this->header.record_stride;
+        if (this->labels.size() > 0)
+        {
+            this->file.write(reinterpret_cast<const char *>(this->labels.getData()), (size_t)this->labels.size() * sizeof(uint32_t));
+        }
+        this->file.seekp(0);
+        this->file.write(reinterpret_cast<const char *>(&this->header), sizeof(ShardHeader));
+        this->file.close();
+        if (this->file.fail())
+        {
+            throw std::runtime_error(std::format("Error ShardWriter, failed to write file \"{}\"", this->path.string()));
+        }
+    }
+};
+
+/**
+ * @brief Memory mapped shard file, records are read in place without decode
+ * @ingroup LanternFile
+ */
+class ShardFile
+{
+private:
+    MappedFile file;
+    const ShardHeader *header = nullptr;
+    const uint8_t *records = nullptr;
+    const uint32_t *labels = nullptr;
+    lantern::utility::Vector<std::string> class_names;
+
+public:
+    ShardFile() {}
+    ShardFile(const ShardFile &) = delete;
+    ShardFile &operator=(const ShardFile &) = delete;
+
+    ShardFile(ShardFile &&_shard) noexcept
+        : file(std::move(_shard.file)), header(_shard.header), records(_shard.records), labels(_shard.labels)
+    {
+        this->class_names = std::move(_shard.class_names);
+        _shard.header = nullptr;
+    }
+
+    /**
+     * @brief Map the shard and check its layout
+     * @param _path
+     */
+    void Open(const std::filesystem::path &_path)
+    {
+        this->file.Open(_path, true);
+        const uint8_t *data = this->file.GetData();
+        uint64_t size = this->file.GetSize();
+        if (size < sizeof(ShardHeader) || reinterpret_cast<const ShardHeader *>(data)->magic != shard_magic)
+        {
+            throw std::runtime_error(std::format("Error ShardFile, \"{}\" is not shard file", _path.string()));
+        }
+        const ShardHeader *_header = reinterpret_cast<const ShardHeader *>(data);
+        uint64_t record_size = (uint64_t)_header->width * _header->height * _header->channels;
+        if (_header->names_offset + _header->names_size > size ||
+            _header->records_offset % shard_record_alignment != 0 ||
+            _header->record_stride < record_size ||
+            _header->records_offset + (uint64_t)_header->record_count * _header->record_stride > size ||
+            _header->labels_offset + (uint64_t)_header->record_count * sizeof(uint32_t) > size ||
+            _header->labels_offset % sizeof(uint32_t) != 0)
+        {
+            throw std::runtime_error(std::format("Error ShardFile, \"{}\" is truncated or corrupted", _path.string()));
+        }
+
+        this->class_names.clean();
+        const uint8_t *names = data + _header->names_offset;
+        const uint8_t *names_end = names + _header->names_size;
+        for (uint32_t c = 0; c < _header->class_count; c++)
+        {
+            uint32_t length;
+            if (names + sizeof(length) > names_end)
+            {
+                throw std::runtime_error(std::format("Error ShardFile, \"{}\" has corrupted class table", _path.string()));
+            }
+            std::memcpy(&length, names, sizeof(length));
+            names += sizeof(length);
+            if (names + length > names_end)
+            {
+                throw std::runtime_error(std::format("Error ShardFile, \"{}\" has corrupted class table", _path.string()));
+            }
+            this->class_names.push_back(std::string(reinterpret_cast<const char *>(names), length));
+            names += length;
+        }
+
+        this->labels = reinterpret_cast<const uint32_t *>(data + _header->labels_offset);
+        for (uint32_t i = 0; i < _header->record_count; i++)
+        {
+            if (this->labels[i] >= _header->class_count)
+            {
+                throw std::runtime_error(std::format("Error ShardFile, \"{}\" has label id out of bound", _path.string()));
+            }
+        }
+        this->records = data + _header->records_offset;
+        this->header = _header;
+    }
+
+    uint32_t GetWidth() const
+    {
+        return this->header->width;
+    }
+
+    uint32_t GetHeight() const
+    {
+        return this->header->height;
+    }
+
+    uint32_t GetChannels() const
+    {
+        return this->header->channels;
+    }
+
+    uint32_t Size() const
+    {
+        return this->header->record_count;
+    }
+
+    uint32_t GetTotalClass() const
+    {
+        return this->header->class_count;
+    }
+
+    /**
+     * @brief Get pixels of the record, valid while the shard is open
+     * @param _index
+     * @return const uint8_t*
+     */
+    const uint8_t *GetRecord(const uint32_t &_index) const
+    {
+        return this->records + (uint64_t)_index * this->header->record_stride;
+    }
+
+    uint32_t GetLabelId(const uint32_t &_index) const
+    {
+        return this->labels[_index];
+    }
+
+    const std::string &GetClassName(const uint32_t &_label_id) const
+    {
+        return this->class_names.getData()[_label_id];
+    }
+};
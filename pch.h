@@ -1,6 +1,7 @@
 #pragma once
 #define NOMINMAX
 #include <cstdint>
+#include <cstring>
 #include <arrayfire.h>
 #include <filesystem>
 #include <fstream>
@@ -11,4 +12,6 @@
 #include <atomic>
 #include <stacktrace>
 #include <random>
-#include <array>
\ No newline at end of file
+#include <limits>
+#include <array>
+#include <optional>
\ No newline at end of file
@@ -10,7 +10,7 @@ int main()
     try
     {
         std::string _current_path = std::filesystem::current_path().string();
-        LanternImageLoader<10, 200, 200, true> loader;
+        LanternImageLoader<10, 200, 200, lantern::data::PixelRGB> loader;
         loader.CreateDatasetForFolder("trains");
         loader.SelectDatasetToModify("trains");
         loader.GetImagesDataFromFolder(_current_path + "/../dataset/cats");
@@ -31,7 +31,7 @@ int main()
         while(true){
             for (uint32_t i = 0; i < 10; i++)
             {
-                loader.GetaAsAF(img_data[i],label[i]);
+                loader.GetAsAF(img_data[i],label[i]);
             }
             do
             {
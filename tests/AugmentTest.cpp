@@ -0,0 +1,158 @@
+#include "Check.h"
+#include "../headers/Vector.h"
+#include "../headers/Augment.h"
+
+namespace
+{
+    // widths around the 16 pixel blocks of the SIMD flip, and odd sizes so the gain and bias tail run too
+    constexpr uint32_t widths[] = {1, 2, 3, 15, 16, 17, 31, 32, 33, 47, 48, 63, 100};
+    constexpr uint32_t height = 3;
+
+    lantern::utility::Vector<uint8_t> RandomImage(const uint32_t &_width, const uint32_t &_channels, const uint32_t &_seed)
+    {
+        uint32_t size = _width * height * _channels;
+        lantern::utility::Vector<uint8_t> image(size);
+        image.explicitTotalItem(size);
+        std::mt19937 random(_seed);
+        for (uint32_t i = 0; i < size; i++)
+        {
+            image.getData()[i] = static_cast<uint8_t>(random());
+        }
+        return image;
+    }
+
+    // every row mirrored pixel by pixel, channel order inside a pixel kept
+    void TestFlip()
+    {
+        for (uint32_t channels = 1; channels <= 4; channels++)
+        {
+            for (uint32_t width : widths)
+            {
+                auto source = RandomImage(width, channels, width * 4 + channels);
+                auto image = RandomImage(width, channels, width * 4 + channels);
+                lantern::data::FlipHorizontal(image.getData(), width, height, channels);
+                uint32_t wrong = 0;
+                for (uint32_t y = 0; y < height; y++)
+                {
+                    for (uint32_t x = 0; x < width; x++)
+                    {
+                        for (uint32_t c = 0; c < channels; c++)
+                        {
+                            uint8_t expected = source.getData()[((size_t)y * width + (width - 1 - x)) * channels + c];
+                            wrong += image.getData()[((size_t)y * width + x) * channels + c] == expected ? 0 : 1;
+                        }
+                    }
+                }
+                LANTERN_CHECK(wrong == 0);
+
+                lantern::data::FlipHorizontal(image.getData(), width, height, channels);
+                LANTERN_CHECK(std::equal(image.getData(), image.getData() + image.size(), source.getData()));
+            }
+        }
+    }
+
+    // color bytes rounded to nearest and saturated, alpha bytes of 2 and 4 channels untouched
+    void TestGainBias()
+    {
+        const float jitters[][2] = {{1.0f, 0.0f}, {1.37f, -20.3f}, {0.61f, 49.7f}, {1.8f, 40.0f}, {0.5f, -80.0f}};
+        for (uint32_t channels = 1; channels <= 4; channels++)
+        {
+            bool has_alpha = channels == 2 || channels == 4;
+            for (uint32_t width : widths)
+            {
+                for (auto &jitter : jitters)
+                {
+                    auto source = RandomImage(width, channels, width + channels * 131);
+                    auto image = RandomImage(width, channels, width + channels * 131);
+                    lantern::data::AdjustGainBias(image.getData(), image.size(), channels, jitter[0], jitter[1]);
+                    uint32_t wrong = 0;
+                    for (uint32_t i = 0; i < image.size(); i++)
+                    {
+                        uint8_t pixel = source.getData()[i], value = image.getData()[i];
+                        if (has_alpha && i % channels == channels - 1)
+                        {
+                            wrong += value == pixel ? 0 : 1;
+                            continue;
+                        }
+                        double exact = static_cast<double>(pixel) * jitter[0] + jitter[1];
+                        long expected = std::clamp<long>(std::lrint(exact), 0, 255);
+                        // float rounding may land on either side of a half
+                        bool half = std::abs(exact - std::floor(exact) - 0.5) < 1e-3;
+                        wrong += value == expected || (half && std::abs(value - expected) == 1) ? 0 : 1;
+                    }
+                    LANTERN_CHECK(wrong == 0);
+                }
+            }
+        }
+    }
+
+    // the crop stay inside the image within the area and ratio ranges, and only depend on the seed
+    void TestCrop()
+    {
+        lantern::data::Augmentation augmentation;
+        augmentation.crop_scale_min = 0.3f;
+        augmentation.crop_scale_max = 0.8f;
+        const uint32_t width = 120, height = 90;
+        uint32_t outside = 0, out_of_range = 0, different = 0;
+        for (uint64_t seed = 0; seed < 500; seed++)
+        {
+            uint64_t sample_seed = lantern::data::SampleSeed(9, seed, 3);
+            auto rect = lantern::data::DrawCrop(augmentation, sample_seed, width, height);
+            auto again = lantern::data::DrawCrop(augmentation, sample_seed, width, height);
+            different += rect.x == again.x && rect.y == again.y && rect.width == again.width && rect.height == again.height ? 0 : 1;
+            outside += rect.width > 0 && rect.height > 0 && rect.x + rect.width <= width && rect.y + rect.height <= height ? 0 : 1;
+            // one pixel of rounding on each side
+            float area = static_cast<float>(rect.width) * rect.height / (width * height);
+            float low_area = static_cast<float>(rect.width - 1) * (rect.height - 1) / (width * height);
+            float high_area = static_cast<float>(rect.width + 1) * (rect.height + 1) / (width * height);
+            float low_ratio = (rect.width - 1.0f) / (rect.height + 1.0f), high_ratio = (rect.width + 1.0f) / (rect.height - 1.0f);
+            bool in_range = high_area >= augmentation.crop_scale_min && low_area <= augmentation.crop_scale_max &&
+                            high_ratio >= augmentation.crop_ratio_min && low_ratio <= augmentation.crop_ratio_max && area <= 1.0f;
+            out_of_range += in_range ? 0 : 1;
+        }
+        LANTERN_CHECK(different == 0);
+        LANTERN_CHECK(outside == 0);
+        LANTERN_CHECK(out_of_range == 0);
+
+        // no crop of a wide image fit the ratio range, fall back to the centered crop of the largest allowed ratio
+        lantern::data::Augmentation wide;
+        wide.crop_scale_min = 0.9f;
+        auto rect = lantern::data::DrawCrop(wide, 1, 100, 10);
+        LANTERN_CHECK(rect.width == 13 && rect.height == 10 && rect.x == 43 && rect.y == 0);
+    }
+
+    // the jitter of a sample only depend on its seed and stay inside the configured range
+    void TestJitter()
+    {
+        lantern::data::Augmentation augmentation;
+        augmentation.flip_probability = 0.5f;
+        augmentation.brightness = 0.2f;
+        augmentation.contrast = 0.3f;
+        uint32_t flips = 0, out_of_range = 0;
+        for (uint64_t seed = 0; seed < 1000; seed++)
+        {
+            auto jitter = lantern::data::DrawJitter(augmentation, seed);
+            auto again = lantern::data::DrawJitter(augmentation, seed);
+            LANTERN_CHECK(jitter.flip == again.flip && jitter.gain == again.gain && jitter.bias == again.bias);
+            flips += jitter.flip ? 1 : 0;
+            float shift = (jitter.bias - 128.0f * (1.0f - jitter.gain)) / 255.0f;
+            bool in_range = jitter.gain >= 0.7f && jitter.gain <= 1.3f && shift >= -0.2001f && shift <= 0.2001f;
+            out_of_range += in_range ? 0 : 1;
+        }
+        LANTERN_CHECK(out_of_range == 0);
+        LANTERN_CHECK(flips > 400 && flips < 600);
+
+        lantern::data::Augmentation none;
+        auto jitter = lantern::data::DrawJitter(none, 5);
+        LANTERN_CHECK(!jitter.flip && jitter.gain == 1.0f && jitter.bias == 0.0f);
+    }
+}
+
+int main()
+{
+    TestFlip();
+    TestGainBias();
+    TestCrop();
+    TestJitter();
+    return LanternTestResult();
+}
@@ -0,0 +1,112 @@
+#include "Check.h"
+#include "../headers/File.h"
+
+namespace
+{
+    std::filesystem::path WriteFile(const std::string &_name, const std::string &_content)
+    {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / _name;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(_content.data(), _content.size());
+        return path;
+    }
+
+    void TestQuotes()
+    {
+        CSVFile csv = ReadCSVFile(WriteFile("lantern_quotes.csv",
+                                            "path,label\n"
+                                            "\"a,b.png\",cat\n"
+                                            "\"multi\nline.png\",\"say \"\"hi\"\"\"\n"
+                                            "plain.png,\"\"\n"));
+        LANTERN_CHECK(csv.Rows() == 4);
+        LANTERN_CHECK(csv.Cols() == 2);
+        LANTERN_CHECK(csv.Get<std::string>(1, 0) == "a,b.png");
+        LANTERN_CHECK(csv.Get<std::string>(2, 0) == "multi\nline.png");
+        LANTERN_CHECK(csv.Get<std::string>(2, 1) == "say \"hi\"");
+        LANTERN_CHECK(csv.View(2, 1) == "say \"\"hi\"\"");
+        LANTERN_CHECK(csv.Get<std::string>(3, 1).empty());
+    }
+
+    // BOM, CRLF, blank lines and a last line without newline
+    void TestLineEndings()
+    {
+        CSVFile csv = ReadCSVFile(WriteFile("lantern_lines.csv", "\xef\xbb\xbfid,value\r\n1,10\r\n\r\n2,20\n\n3,30"));
+        LANTERN_CHECK(csv.Rows() == 4);
+        LANTERN_CHECK(csv.Get<std::string>(0, 0) == "id");
+        LANTERN_CHECK(csv.Get<int>(1, 1) == 10);
+        LANTERN_CHECK(csv.Get<int>(2, 1) == 20);
+        LANTERN_CHECK(csv.Get<int>(3, 1) == 30);
+        auto ids = csv.Col<std::string>(0);
+        LANTERN_CHECK(ids.size() == 4 && ids[3] == "3");
+        auto row = csv.Row<float>(2);
+        LANTERN_CHECK(row.size() == 2 && row[1] == 20.0f);
+    }
+
+    // with one column an empty line is a row with an empty cell
+    void TestOneColumn()
+    {
+        CSVFile csv = ReadCSVFile(WriteFile("lantern_one.csv", "name\nalpha\n\nbeta\n"));
+        LANTERN_CHECK(csv.Rows() == 4);
+        LANTERN_CHECK(csv.Cols() == 1);
+        LANTERN_CHECK(csv.Get<std::string>(2, 0).empty());
+        LANTERN_CHECK(csv.Get<std::string>(3, 0) == "beta");
+    }
+
+    // cells and quotes crossing the 64 bytes blocks of the classifier
+    void TestLongFile()
+    {
+        std::string content = "path,label\n";
+        for (uint32_t i = 0; i < 3000; i++)
+        {
+            std::string name(i % 97, 'x');
+            content += "\"" + name + ",\"\"" + std::to_string(i) + "\"\"\"," + std::to_string(i % 5) + "\n";
+        }
+        CSVFile csv = ReadCSVFile(WriteFile("lantern_long.csv", content));
+        LANTERN_CHECK(csv.Rows() == 3001);
+        uint32_t wrong = 0;
+        for (uint32_t i = 0; i < 3000; i++)
+        {
+            std::string name(i % 97, 'x');
+            wrong += csv.Get<std::string>(i + 1, 0) == name + ",\"" + std::to_string(i) + "\"" ? 0 : 1;
+            wrong += csv.Get<uint32_t>(i + 1, 1) == i % 5 ? 0 : 1;
+        }
+        LANTERN_CHECK(wrong == 0);
+    }
+
+    void TestErrors()
+    {
+        auto throws = [](auto &&_call)
+        {
+            try
+            {
+                _call();
+            }
+            catch (const std::runtime_error &)
+            {
+                return true;
+            }
+            return false;
+        };
+        LANTERN_CHECK(throws([]()
+                             { (void)ReadCSVFile(WriteFile("lantern_columns.csv", "a,b\n1,2,3\n")); }));
+        LANTERN_CHECK(throws([]()
+                             { (void)ReadCSVFile(std::filesystem::temp_directory_path() / "lantern_missing.csv"); }));
+        CSVFile csv = ReadCSVFile(WriteFile("lantern_bound.csv", "a,b\n1,x\n"));
+        LANTERN_CHECK(throws([&]()
+                             { csv.Get<int>(1, 1); }));
+        LANTERN_CHECK(throws([&]()
+                             { csv.View(2, 0); }));
+        LANTERN_CHECK(throws([&]()
+                             { csv.Col<int>(2); }));
+    }
+}
+
+int main()
+{
+    TestQuotes();
+    TestLineEndings();
+    TestOneColumn();
+    TestLongFile();
+    TestErrors();
+    return LanternTestResult();
+}
@@ -0,0 +1,156 @@
+#include "Check.h"
+#include "../headers/Vector.h"
+#include "../headers/Cache.h"
+
+namespace
+{
+    constexpr uint32_t width = 7, height = 5, channels = 3, size = width * height * channels;
+
+    std::filesystem::path Directory()
+    {
+        return std::filesystem::temp_directory_path() / "lantern_cache_test";
+    }
+
+    std::string WriteSource(const std::string &_name, const std::string &_content)
+    {
+        std::filesystem::path path = Directory() / _name;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << _content;
+        return path.string();
+    }
+
+    lantern::utility::Vector<uint8_t> Pixels(const uint8_t &_first)
+    {
+        lantern::utility::Vector<uint8_t> pixels(size);
+        pixels.explicitTotalItem(size);
+        for (uint32_t i = 0; i < size; i++)
+        {
+            pixels.getData()[i] = static_cast<uint8_t>(_first + i * 7);
+        }
+        return pixels;
+    }
+
+    uint32_t CountFiles(const std::string &_extension)
+    {
+        uint32_t total = 0;
+        for (auto &entry : std::filesystem::directory_iterator(Directory() / "cache"))
+        {
+            total += entry.path().extension() == _extension ? 1 : 0;
+        }
+        return total;
+    }
+
+    // stored pixels come back for the same key, the entry is written by rename so no temporary file is left
+    void TestRoundTrip(ImageDiskCache &_cache)
+    {
+        std::string a = WriteSource("a.jpg", "first image"), b = WriteSource("b.jpg", "second");
+        ImageDiskCache::Key key_a, key_b;
+        LANTERN_CHECK(ImageDiskCache::MakeKey(a, width, height, channels, key_a));
+        LANTERN_CHECK(ImageDiskCache::MakeKey(b, width, height, channels, key_b));
+        auto pixels_a = Pixels(1), pixels_b = Pixels(100);
+        _cache.Store(key_a, pixels_a.getData(), size);
+        _cache.Store(key_b, pixels_b.getData(), size);
+
+        auto read = Pixels(0);
+        LANTERN_CHECK(_cache.Load(key_a, read.getData(), size));
+        LANTERN_CHECK(std::equal(read.getData(), read.getData() + size, pixels_a.getData()));
+        LANTERN_CHECK(_cache.Load(key_b, read.getData(), size));
+        LANTERN_CHECK(std::equal(read.getData(), read.getData() + size, pixels_b.getData()));
+        LANTERN_CHECK(CountFiles(".lic") == 2);
+        LANTERN_CHECK(CountFiles(".tmp") == 0);
+
+        // same path for another shape is another entry
+        ImageDiskCache::Key smaller;
+        LANTERN_CHECK(ImageDiskCache::MakeKey(a, width - 1, height, channels, smaller));
+        LANTERN_CHECK(!_cache.Load(smaller, read.getData(), (size_t)(width - 1) * height * channels));
+        // the destination size must match the key shape
+        LANTERN_CHECK(!_cache.Load(key_a, read.getData(), size - 1));
+    }
+
+    // an edited source file change its key, the old entry is never served
+    void TestStaleSource(ImageDiskCache &_cache)
+    {
+        std::string path = WriteSource("edited.jpg", "original");
+        ImageDiskCache::Key key;
+        LANTERN_CHECK(ImageDiskCache::MakeKey(path, width, height, channels, key));
+        auto pixels = Pixels(3), read = Pixels(0);
+        _cache.Store(key, pixels.getData(), size);
+        LANTERN_CHECK(_cache.Load(key, read.getData(), size));
+
+        // newer modification time, same size
+        std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(10));
+        ImageDiskCache::Key touched;
+        LANTERN_CHECK(ImageDiskCache::MakeKey(path, width, height, channels, touched));
+        LANTERN_CHECK(touched.mtime != key.mtime && touched.file_size == key.file_size);
+        LANTERN_CHECK(!_cache.Load(touched, read.getData(), size));
+
+        // another size, modification time set back
+        auto mtime = std::filesystem::last_write_time(path);
+        WriteSource("edited.jpg", "original and longer");
+        std::filesystem::last_write_time(path, mtime);
+        ImageDiskCache::Key resized;
+        LANTERN_CHECK(ImageDiskCache::MakeKey(path, width, height, channels, resized));
+        LANTERN_CHECK(resized.mtime == touched.mtime && resized.file_size != touched.file_size);
+        LANTERN_CHECK(!_cache.Load(resized, read.getData(), size));
+
+        // a stored key with a changed field is a miss, not a hit on another entry
+        ImageDiskCache::Key changed = key;
+        changed.file_size++;
+        LANTERN_CHECK(!_cache.Load(changed, read.getData(), size));
+        changed = key;
+        changed.mtime++;
+        LANTERN_CHECK(!_cache.Load(changed, read.getData(), size));
+    }
+
+    // a truncated or foreign entry is a miss, a missing source has no key, and a file cannot be the cache directory
+    void TestBrokenEntries()
+    {
+        // own directory so the entry is the only file in it
+        ImageDiskCache cache;
+        cache.Open((Directory() / "broken").string());
+        std::string path = WriteSource("broken.jpg", "broken");
+        ImageDiskCache::Key key;
+        LANTERN_CHECK(ImageDiskCache::MakeKey(path, width, height, channels, key));
+        auto pixels = Pixels(9), read = Pixels(0);
+        cache.Store(key, pixels.getData(), size);
+        std::filesystem::path entry = std::filesystem::directory_iterator(Directory() / "broken")->path();
+        LANTERN_CHECK(cache.Load(key, read.getData(), size));
+
+        std::filesystem::resize_file(entry, std::filesystem::file_size(entry) - 1);
+        LANTERN_CHECK(!cache.Load(key, read.getData(), size));
+        std::filesystem::resize_file(entry, 8);
+        LANTERN_CHECK(!cache.Load(key, read.getData(), size));
+        std::ofstream(entry, std::ios::binary | std::ios::trunc) << std::string(200, 'x');
+        LANTERN_CHECK(!cache.Load(key, read.getData(), size));
+
+        ImageDiskCache::Key missing;
+        LANTERN_CHECK(!ImageDiskCache::MakeKey((Directory() / "missing.jpg").string(), width, height, channels, missing));
+
+        ImageDiskCache other;
+        bool rejected = false;
+        try
+        {
+            other.Open(path);
+        }
+        catch (const std::runtime_error &)
+        {
+            rejected = true;
+        }
+        LANTERN_CHECK(rejected);
+        LANTERN_CHECK(!other.IsOpen());
+    }
+}
+
+int main()
+{
+    std::filesystem::remove_all(Directory());
+    std::filesystem::create_directories(Directory());
+    ImageDiskCache cache;
+    cache.Open((Directory() / "cache").string());
+    LANTERN_CHECK(cache.IsOpen());
+    TestRoundTrip(cache);
+    TestStaleSource(cache);
+    TestBrokenEntries();
+    std::filesystem::remove_all(Directory());
+    return LanternTestResult();
+}
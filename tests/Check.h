@@ -0,0 +1,29 @@
+#pragma once
+#include "../pch.h"
+#include <iostream>
+
+/**
+ * @brief Minimal check used by the tests, a failed check print its expression and the test keep running,
+ * main return LanternTestResult() so ctest see the failure
+ */
+inline uint32_t lantern_test_failures = 0;
+
+#define LANTERN_CHECK(condition)                                                                  \
+    do                                                                                            \
+    {                                                                                             \
+        if (!(condition))                                                                         \
+        {                                                                                         \
+            std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << '\n';   \
+            lantern_test_failures++;                                                              \
+        }                                                                                         \
+    } while (false)
+
+inline int LanternTestResult()
+{
+    if (lantern_test_failures > 0)
+    {
+        std::cout << lantern_test_failures << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
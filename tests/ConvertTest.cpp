@@ -0,0 +1,119 @@
+#include "Check.h"
+#include "../headers/Vector.h"
+#include "../headers/Convert.h"
+
+namespace
+{
+    using lantern::data::PixelFormat;
+    using lantern::data::PixelType;
+    using lantern::data::TensorLayout;
+
+    // odd shape so the SIMD paths also run their scalar tails
+    constexpr uint32_t width = 37, height = 19;
+
+    float HalfToFloat(const uint16_t &_half)
+    {
+        uint32_t sign = (_half >> 15) & 1, exponent = (_half >> 10) & 0x1f, mantissa = _half & 0x3ff;
+        float value = exponent == 0 ? std::ldexp(static_cast<float>(mantissa), -24)
+                                    : std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+        return sign ? -value : value;
+    }
+
+    template <typename Format>
+    void TestFormat(const lantern::utility::Vector<uint8_t> &_source, const lantern::data::Normalization &_normalization)
+    {
+        constexpr uint32_t channels = Format::channels;
+        const uint8_t *source = _source.getData();
+        std::unique_ptr<typename Format::value_type[]> output(new typename Format::value_type[Format::ImageSize(width, height)]);
+        lantern::data::ConvertImage<Format>(source, output.get(), width, height, _normalization);
+
+        uint32_t wrong = 0;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                for (uint32_t c = 0; c < channels; c++)
+                {
+                    uint8_t pixel = source[((size_t)y * width + x) * channels + c];
+                    auto value = output[x * Format::StrideX(width, height) + y * Format::StrideY(width, height) + c * Format::StrideC(width, height)];
+                    float expected = (pixel * _normalization.scale - _normalization.mean[c]) / _normalization.stddev[c];
+                    bool same;
+                    if constexpr (Format::type == PixelType::UInt8)
+                    {
+                        same = value == pixel;
+                    }
+                    else if constexpr (Format::type == PixelType::UInt16)
+                    {
+                        same = value == pixel * 257u;
+                    }
+                    else if constexpr (Format::type == PixelType::Float16)
+                    {
+                        same = std::abs(HalfToFloat(value) - expected) <= 1e-3f * std::max(1.0f, std::abs(expected));
+                    }
+                    else
+                    {
+                        same = std::abs(value - expected) <= 1e-5f * std::max(1.0f, std::abs(expected));
+                    }
+                    wrong += same ? 0 : 1;
+                }
+            }
+        }
+        LANTERN_CHECK(wrong == 0);
+    }
+
+    template <uint32_t Channels, PixelType Type>
+    void TestLayouts(const lantern::utility::Vector<uint8_t> &_source, const lantern::data::Normalization &_normalization)
+    {
+        TestFormat<PixelFormat<Channels, Type, TensorLayout::HWC>>(_source, _normalization);
+        TestFormat<PixelFormat<Channels, Type, TensorLayout::CHW>>(_source, _normalization);
+        TestFormat<PixelFormat<Channels, Type, TensorLayout::CWH>>(_source, _normalization);
+    }
+
+    template <uint32_t Channels>
+    void TestChannels(const lantern::data::Normalization &_normalization)
+    {
+        lantern::utility::Vector<uint8_t> source(width * height * Channels);
+        source.explicitTotalItem(width * height * Channels);
+        std::mt19937 random(Channels);
+        for (uint32_t i = 0; i < source.size(); i++)
+        {
+            source.getData()[i] = static_cast<uint8_t>(random());
+        }
+        TestLayouts<Channels, PixelType::UInt8>(source, _normalization);
+        TestLayouts<Channels, PixelType::UInt16>(source, _normalization);
+        TestLayouts<Channels, PixelType::Float16>(source, _normalization);
+        TestLayouts<Channels, PixelType::Float32>(source, _normalization);
+    }
+
+    // the runtime converter resolve to the same instantiation as the compile time format
+    void TestConvertToFloat()
+    {
+        lantern::utility::Vector<uint8_t> source(width * height * 3);
+        source.explicitTotalItem(width * height * 3);
+        for (uint32_t i = 0; i < source.size(); i++)
+        {
+            source.getData()[i] = static_cast<uint8_t>(i * 7);
+        }
+        std::unique_ptr<float[]> runtime(new float[width * height * 3]), compiled(new float[width * height * 3]);
+        lantern::data::ConvertToFloat(source.getData(), runtime.get(), width, height, 3, TensorLayout::CHW);
+        lantern::data::ConvertImage<PixelFormat<3, PixelType::Float32, TensorLayout::CHW>>(source.getData(), compiled.get(), width, height);
+        LANTERN_CHECK(std::memcmp(runtime.get(), compiled.get(), sizeof(float) * width * height * 3) == 0);
+    }
+}
+
+int main()
+{
+    lantern::data::Normalization scale_only;
+    lantern::data::Normalization imagenet;
+    imagenet.mean = {0.485f, 0.456f, 0.406f, 0.5f};
+    imagenet.stddev = {0.229f, 0.224f, 0.225f, 0.25f};
+    for (auto &normalization : {scale_only, imagenet})
+    {
+        TestChannels<1>(normalization);
+        TestChannels<2>(normalization);
+        TestChannels<3>(normalization);
+        TestChannels<4>(normalization);
+    }
+    TestConvertToFloat();
+    return LanternTestResult();
+}
@@ -0,0 +1,96 @@
+#include "Check.h"
+#include "../headers/PathPool.h"
+
+namespace
+{
+    using lantern::utility::PathLayout;
+    using lantern::utility::PathPool;
+
+    // files of several directories, names sharing long prefixes and a few odd ones
+    lantern::utility::Vector<std::string> MakePaths()
+    {
+        lantern::utility::Vector<std::string> paths;
+        for (uint32_t d = 0; d < 7; d++)
+        {
+            for (uint32_t i = 0; i < 45; i++)
+            {
+                std::string number = std::to_string(i * 3);
+                paths.push_back("/data/train/class_" + std::to_string(d) + "/image_" + std::string(6 - number.size(), '0') + number + ".jpg");
+            }
+        }
+        paths.push_back("relative.png");
+        paths.push_back("C:\\dataset\\cat\\001.png");
+        paths.push_back("C:\\dataset\\cat\\");
+        paths.push_back("/data/train/class_0/image_000000.jpg"); // directory seen again after others
+        return paths;
+    }
+
+    void CheckRoundTrip(const PathPool &pool, lantern::utility::Vector<std::string> &paths)
+    {
+        LANTERN_CHECK(pool.Size() == paths.size());
+        std::string path;
+        uint32_t wrong = 0;
+        // random access order, front coded blocks are decoded from their first name
+        for (uint32_t k = 0; k < paths.size(); k++)
+        {
+            uint32_t i = (k * 97) % paths.size();
+            pool.Get(i, path);
+            wrong += path == paths[i] ? 0 : 1;
+        }
+        LANTERN_CHECK(wrong == 0);
+        LANTERN_CHECK(pool.Get(0) == paths[0]);
+    }
+
+    void TestLayout(const PathLayout &_layout)
+    {
+        auto paths = MakePaths();
+        PathPool pool(_layout);
+        LANTERN_CHECK(pool.Empty());
+        for (auto &path : paths)
+        {
+            pool.Push(path);
+        }
+        LANTERN_CHECK(!pool.Empty());
+        LANTERN_CHECK(pool.GetLayout() == _layout);
+        CheckRoundTrip(pool, paths);
+    }
+
+    // the paths already added survive a layout change both ways, and front coding take less memory
+    void TestSetLayout()
+    {
+        auto paths = MakePaths();
+        PathPool pool;
+        for (auto &path : paths)
+        {
+            pool.Push(path);
+        }
+        size_t plain = pool.MemoryUsage();
+        pool.SetLayout(PathLayout::FrontCoded);
+        LANTERN_CHECK(pool.GetLayout() == PathLayout::FrontCoded);
+        CheckRoundTrip(pool, paths);
+        LANTERN_CHECK(pool.MemoryUsage() < plain);
+        pool.SetLayout(PathLayout::Plain);
+        CheckRoundTrip(pool, paths);
+    }
+
+    void TestMove()
+    {
+        auto paths = MakePaths();
+        PathPool pool(PathLayout::FrontCoded);
+        for (auto &path : paths)
+        {
+            pool.Push(path);
+        }
+        PathPool moved = std::move(pool);
+        CheckRoundTrip(moved, paths);
+    }
+}
+
+int main()
+{
+    TestLayout(PathLayout::Plain);
+    TestLayout(PathLayout::FrontCoded);
+    TestSetLayout();
+    TestMove();
+    return LanternTestResult();
+}
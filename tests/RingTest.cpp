@@ -0,0 +1,118 @@
+#include "Check.h"
+#include "../headers/Vector.h"
+#include "../headers/Ring.h"
+
+namespace
+{
+    // positions keep growing while the slots wrap around the ring many times
+    void TestWrapAround()
+    {
+        lantern::utility::SlotRing ring;
+        ring.Reset(3, true);
+        LANTERN_CHECK(ring.getCapacity() == 3);
+        for (uint64_t expected = 0; expected < 100; expected++)
+        {
+            uint64_t write = 0, read = 0;
+            LANTERN_CHECK(ring.TryReserveWrite(write));
+            LANTERN_CHECK(write == expected);
+            LANTERN_CHECK(ring.SlotOf(write) == expected % 3);
+            ring.PublishWrite(write);
+            LANTERN_CHECK(ring.TryReserveRead(read));
+            LANTERN_CHECK(read == write);
+            ring.ReleaseRead(read);
+        }
+        uint64_t pos = 0;
+        LANTERN_CHECK(!ring.TryReserveRead(pos));
+    }
+
+    // a full ring refuse the writer until the oldest slot is released, and a reserved slot count as pending
+    void TestFullRing()
+    {
+        lantern::utility::SlotRing ring;
+        ring.Reset(2, true);
+        uint64_t pos[2] = {0, 0}, extra = 0;
+        for (auto &p : pos)
+        {
+            LANTERN_CHECK(ring.TryReserveWrite(p));
+            ring.PublishWrite(p);
+        }
+        LANTERN_CHECK(!ring.TryReserveWrite(extra));
+        uint64_t read = 0;
+        LANTERN_CHECK(ring.TryReserveRead(read) && read == 0);
+        LANTERN_CHECK(ring.HasPendingReads());
+        LANTERN_CHECK(!ring.TryReserveWrite(extra));
+        ring.ReleaseRead(read);
+        LANTERN_CHECK(!ring.HasPendingReads());
+        LANTERN_CHECK(ring.TryReserveWrite(extra) && extra == 2 && ring.SlotOf(extra) == 0);
+    }
+
+    // several producers and one consumer, every value arrive exactly once
+    void TestProducersConsumer()
+    {
+        constexpr uint32_t producers = 4, per_producer = 5000;
+        lantern::utility::SlotRing ring;
+        ring.Reset(8, false);
+        uint32_t values[8];
+        lantern::utility::Vector<std::thread> threads;
+        for (uint32_t p = 0; p < producers; p++)
+        {
+            threads.push_back(std::thread([&, p]()
+                                          {
+                for (uint32_t i = 0; i < per_producer; i++)
+                {
+                    uint64_t pos = 0;
+                    if (!ring.ReserveWrite(pos))
+                    {
+                        return;
+                    }
+                    values[ring.SlotOf(pos)] = p * per_producer + i;
+                    ring.PublishWrite(pos);
+                } }));
+        }
+        lantern::utility::Vector<uint8_t> seen(producers * per_producer, 0);
+        for (uint32_t i = 0; i < producers * per_producer; i++)
+        {
+            uint64_t pos = 0;
+            bool reserved = ring.ReserveRead(pos);
+            LANTERN_CHECK(reserved);
+            if (!reserved)
+            {
+                break;
+            }
+            seen[values[ring.SlotOf(pos)]]++;
+            ring.ReleaseRead(pos);
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        uint32_t wrong = 0;
+        for (auto count : seen)
+        {
+            wrong += count == 1 ? 0 : 1;
+        }
+        LANTERN_CHECK(wrong == 0);
+    }
+
+    void TestStop()
+    {
+        lantern::utility::SlotRing ring;
+        ring.Reset(2, true);
+        std::thread consumer([&]()
+                             {
+            uint64_t pos = 0;
+            LANTERN_CHECK(!ring.ReserveRead(pos)); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ring.Stop();
+        consumer.join();
+    }
+}
+
+int main()
+{
+    TestWrapAround();
+    TestFullRing();
+    TestProducersConsumer();
+    TestStop();
+    return LanternTestResult();
+}
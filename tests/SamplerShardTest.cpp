@@ -0,0 +1,117 @@
+#include "Check.h"
+#include "../headers/DataProcessing.h"
+
+namespace
+{
+    lantern::utility::Vector<uint32_t> Sizes(std::initializer_list<uint32_t> _sizes)
+    {
+        lantern::utility::Vector<uint32_t> sizes;
+        for (auto size : _sizes)
+        {
+            sizes.push_back(size);
+        }
+        return sizes;
+    }
+
+    // every rank run the same number of draws and together they cover every image of every class
+    void TestUnevenClassesArePadded()
+    {
+        auto sizes = Sizes({5, 17, 1, 40, 9});
+        const uint32_t world_size = 3, total_images = 72;
+        lantern::utility::Vector<uint32_t> seen(total_images, 0);
+        for (uint32_t rank = 0; rank < world_size; rank++)
+        {
+            lantern::data::EpochSampler sampler;
+            sampler.Setup(sizes, 2024, rank, world_size);
+            // ceil(size / world_size) per class
+            LANTERN_CHECK(sampler.GetTotal() == 2 + 6 + 1 + 14 + 3);
+            LANTERN_CHECK(sampler.GetTotalClass() == 5);
+            uint32_t total = sampler.GetTotal();
+            lantern::utility::Vector<uint32_t> out(total);
+            out.explicitTotalItem(total);
+            sampler.Next(out.getData(), total);
+            for (auto index : out)
+            {
+                LANTERN_CHECK(index < total_images);
+                seen[index]++;
+            }
+        }
+        for (auto count : seen)
+        {
+            LANTERN_CHECK(count >= 1);
+        }
+    }
+
+    // classes that split evenly give disjoint shards that cover the dataset exactly once
+    void TestEvenShardsAreDisjoint()
+    {
+        auto sizes = Sizes({12, 8, 4});
+        const uint32_t world_size = 4;
+        lantern::utility::Vector<uint32_t> seen(24, 0);
+        for (uint32_t rank = 0; rank < world_size; rank++)
+        {
+            lantern::data::EpochSampler sampler;
+            sampler.Setup(sizes, 11, rank, world_size);
+            LANTERN_CHECK(sampler.GetTotal() == 6);
+            lantern::utility::Vector<uint32_t> out(6);
+            out.explicitTotalItem(6);
+            sampler.Next(out.getData(), 6);
+            uint32_t per_class[3] = {0, 0, 0};
+            for (auto index : out)
+            {
+                seen[index]++;
+                per_class[index < 12 ? 0 : index < 20 ? 1 : 2]++;
+            }
+            LANTERN_CHECK(per_class[0] == 3 && per_class[1] == 2 && per_class[2] == 1);
+        }
+        for (auto count : seen)
+        {
+            LANTERN_CHECK(count == 1);
+        }
+    }
+
+    void TestStateKeepRank()
+    {
+        auto sizes = Sizes({10, 7});
+        lantern::data::EpochSampler sampler, other;
+        sampler.Setup(sizes, 3, 1, 2);
+        other.Setup(sizes, 3, 0, 2);
+        lantern::data::SamplerState state = sampler.GetState();
+        LANTERN_CHECK(state.rank == 1 && state.world_size == 2);
+        bool rejected = false;
+        try
+        {
+            other.SetState(state);
+        }
+        catch (const std::runtime_error &)
+        {
+            rejected = true;
+        }
+        LANTERN_CHECK(rejected);
+    }
+
+    void TestInvalidRank()
+    {
+        auto sizes = Sizes({4});
+        lantern::data::EpochSampler sampler;
+        bool rejected = false;
+        try
+        {
+            sampler.Setup(sizes, 1, 2, 2);
+        }
+        catch (const std::runtime_error &)
+        {
+            rejected = true;
+        }
+        LANTERN_CHECK(rejected);
+    }
+}
+
+int main()
+{
+    TestUnevenClassesArePadded();
+    TestEvenShardsAreDisjoint();
+    TestStateKeepRank();
+    TestInvalidRank();
+    return LanternTestResult();
+}
@@ -0,0 +1,205 @@
+#include "Check.h"
+#include "../headers/DataProcessing.h"
+
+namespace
+{
+    lantern::utility::Vector<uint32_t> Sizes(std::initializer_list<uint32_t> _sizes)
+    {
+        lantern::utility::Vector<uint32_t> sizes;
+        for (auto size : _sizes)
+        {
+            sizes.push_back(size);
+        }
+        return sizes;
+    }
+
+    lantern::utility::Vector<uint32_t> Draw(lantern::data::EpochSampler &sampler, const uint32_t &count)
+    {
+        lantern::utility::Vector<uint32_t> out(count);
+        out.explicitTotalItem(count);
+        sampler.Next(out.getData(), count);
+        return out;
+    }
+
+    bool Same(lantern::utility::Vector<uint32_t> &a, lantern::utility::Vector<uint32_t> &b)
+    {
+        return a.size() == b.size() && std::equal(a.getData(), a.getData() + a.size(), b.getData());
+    }
+
+    // every index once per epoch, and after every batch each class gave floor or ceil of its share
+    void TestStratifiedEpoch()
+    {
+        auto sizes = Sizes({30, 10, 3});
+        lantern::data::EpochSampler sampler;
+        sampler.Setup(sizes, 42);
+        LANTERN_CHECK(sampler.GetTotal() == 43);
+        LANTERN_CHECK(sampler.GetTotalClass() == 3);
+
+        lantern::utility::Vector<uint32_t> seen(43, 0);
+        uint32_t taken[3] = {0, 0, 0}, drawn = 0;
+        while (drawn < 43)
+        {
+            uint32_t count = std::min<uint32_t>(8, 43 - drawn);
+            auto batch = Draw(sampler, count);
+            for (auto index : batch)
+            {
+                seen[index]++;
+                taken[index < 30 ? 0 : index < 40 ? 1 : 2]++;
+            }
+            drawn += count;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                uint32_t share = drawn * sizes[c];
+                LANTERN_CHECK(taken[c] >= share / 43 && taken[c] <= (share + 42) / 43);
+            }
+        }
+        for (auto count : seen)
+        {
+            LANTERN_CHECK(count == 1);
+        }
+        LANTERN_CHECK(sampler.GetEpoch() == 1);
+    }
+
+    // more classes than the batch and uneven sizes, every call write exactly its batch and the epoch is covered once
+    void CheckManyClasses(lantern::utility::Vector<uint32_t> &sizes, const uint32_t &batch)
+    {
+        lantern::data::EpochSampler sampler;
+        sampler.Setup(sizes, 77);
+        uint32_t total = sampler.GetTotal(), total_class = sampler.GetTotalClass();
+        const uint32_t guard = 64, sentinel = 0xffffffffu;
+        lantern::utility::Vector<uint32_t> out(batch + guard), taken(total_class), seen(total, 0);
+        out.explicitTotalItem(batch + guard);
+        taken.explicitTotalItem(total_class);
+        uint32_t drawn = 0;
+        while (drawn < total)
+        {
+            uint32_t count = std::min(batch, total - drawn);
+            std::fill(out.getData(), out.getData() + batch + guard, sentinel);
+            sampler.Next(out.getData(), count);
+            bool written = true, untouched = true;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                written = written && out[i] < total;
+                if (out[i] < total)
+                {
+                    seen[out[i]]++;
+                }
+            }
+            for (uint32_t i = count; i < batch + guard; i++)
+            {
+                untouched = untouched && out[i] == sentinel;
+            }
+            LANTERN_CHECK(written);
+            LANTERN_CHECK(untouched);
+            drawn += count;
+            if (drawn < total)
+            {
+                sampler.CopyClassTaken(taken.getData());
+                bool within = true;
+                for (uint32_t c = 0; c < total_class; c++)
+                {
+                    uint64_t share = (uint64_t)drawn * sizes[c];
+                    within = within && taken[c] <= (share + total - 1) / total;
+                }
+                LANTERN_CHECK(within);
+            }
+        }
+        bool once = true;
+        for (auto count : seen)
+        {
+            once = once && count == 1;
+        }
+        LANTERN_CHECK(once);
+        LANTERN_CHECK(sampler.GetEpoch() == 1 && sampler.GetPosition() == 0);
+    }
+
+    void TestManyUnevenClasses()
+    {
+        auto small = Sizes({13, 18, 12, 34, 34, 34, 36});
+        CheckManyClasses(small, 2);
+        lantern::utility::Vector<uint32_t> many;
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            many.push_back(20 + i % 37);
+        }
+        CheckManyClasses(many, 32);
+    }
+
+    // same seed give the same order, another epoch give another order
+    void TestSeed()
+    {
+        auto sizes = Sizes({20, 20});
+        lantern::data::EpochSampler a, b;
+        a.Setup(sizes, 7);
+        b.Setup(sizes, 7);
+        auto first = Draw(a, 40), second = Draw(b, 40), next = Draw(a, 40);
+        LANTERN_CHECK(Same(first, second));
+        LANTERN_CHECK(!Same(first, next));
+    }
+
+    // a sampler resumed from the state continue with the exact same indices, also across the epoch end
+    void TestSetStateRoundTrip()
+    {
+        auto sizes = Sizes({17, 9, 5});
+        for (uint32_t skip : {0u, 13u, 29u, 31u, 45u})
+        {
+            lantern::data::EpochSampler original;
+            original.Setup(sizes, 1234);
+            Draw(original, skip);
+            lantern::data::SamplerState state = original.GetState();
+            auto expected = Draw(original, 40);
+
+            lantern::data::EpochSampler resumed;
+            resumed.Setup(sizes, 99);
+            resumed.SetState(state);
+            auto actual = Draw(resumed, 40);
+            LANTERN_CHECK(Same(expected, actual));
+            LANTERN_CHECK(resumed.GetEpoch() == original.GetEpoch());
+            LANTERN_CHECK(resumed.GetPosition() == original.GetPosition());
+        }
+    }
+
+    void TestSerialize()
+    {
+        auto sizes = Sizes({12, 4});
+        lantern::data::EpochSampler sampler;
+        sampler.Setup(sizes, 5);
+        Draw(sampler, 23);
+        lantern::data::SamplerState state = sampler.GetState();
+        auto bytes = state.Serialize();
+        lantern::data::SamplerState read = lantern::data::SamplerState::Deserialize(bytes.getData(), bytes.size());
+        LANTERN_CHECK(read.seed == state.seed);
+        LANTERN_CHECK(read.total == state.total);
+        LANTERN_CHECK(read.rank == state.rank && read.world_size == state.world_size);
+        LANTERN_CHECK(read.cursor.epoch == state.cursor.epoch && read.cursor.position == state.cursor.position);
+        LANTERN_CHECK(read.cursor.rng_state == state.cursor.rng_state && read.cursor.rng_inc == state.cursor.rng_inc);
+        LANTERN_CHECK(Same(read.class_taken, state.class_taken));
+
+        lantern::data::EpochSampler resumed;
+        resumed.Setup(sizes, 5);
+        resumed.SetState(read);
+        auto expected = Draw(sampler, 16), actual = Draw(resumed, 16);
+        LANTERN_CHECK(Same(expected, actual));
+
+        bool rejected = false;
+        try
+        {
+            lantern::data::SamplerState::Deserialize(bytes.getData(), bytes.size() - 1);
+        }
+        catch (const std::runtime_error &)
+        {
+            rejected = true;
+        }
+        LANTERN_CHECK(rejected);
+    }
+}
+
+int main()
+{
+    TestStratifiedEpoch();
+    TestManyUnevenClasses();
+    TestSeed();
+    TestSetStateRoundTrip();
+    TestSerialize();
+    return LanternTestResult();
+}
@@ -0,0 +1,188 @@
+#include "Check.h"
+#include "../headers/Vector.h"
+#include "../headers/Shard.h"
+
+namespace
+{
+    // record size is not a multiple of the record alignment, so every record is padded
+    constexpr uint32_t width = 5, height = 3, channels = 3, record_size = width * height * channels, total_records = 10;
+
+    std::filesystem::path Directory()
+    {
+        return std::filesystem::temp_directory_path() / "lantern_shard_test";
+    }
+
+    lantern::utility::Vector<std::string> ClassNames()
+    {
+        lantern::utility::Vector<std::string> names;
+        names.push_back("cat");
+        names.push_back("dog");
+        names.push_back("");
+        names.push_back("a much longer class name");
+        return names;
+    }
+
+    uint8_t PixelOf(const uint32_t &_record, const uint32_t &_byte)
+    {
+        return static_cast<uint8_t>(_record * 31 + _byte);
+    }
+
+    uint32_t LabelOf(const uint32_t &_record)
+    {
+        return (_record * 3) % 4;
+    }
+
+    std::filesystem::path WriteShard(const std::string &_name, const uint32_t &_records)
+    {
+        std::filesystem::path path = Directory() / _name;
+        auto names = ClassNames();
+        ShardWriter writer;
+        writer.Open(path, width, height, channels, names);
+        uint8_t pixels[record_size];
+        for (uint32_t r = 0; r < _records; r++)
+        {
+            for (uint32_t i = 0; i < record_size; i++)
+            {
+                pixels[i] = PixelOf(r, i);
+            }
+            writer.Append(LabelOf(r), pixels);
+        }
+        LANTERN_CHECK(writer.Size() == _records);
+        writer.Close();
+        return path;
+    }
+
+    ShardHeader ReadHeader(const std::filesystem::path &_path)
+    {
+        ShardHeader header{};
+        std::ifstream file(_path, std::ios::binary);
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        return header;
+    }
+
+    bool OpenFails(const std::filesystem::path &_path)
+    {
+        ShardFile shard;
+        try
+        {
+            shard.Open(_path);
+        }
+        catch (const std::runtime_error &)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    // every record, label and class name read back from the mapping, records start at the page aligned offset
+    void TestRoundTrip()
+    {
+        auto path = WriteShard("round_trip.lsh", total_records);
+        ShardHeader header = ReadHeader(path);
+        LANTERN_CHECK(header.records_offset % shard_records_alignment == 0);
+        LANTERN_CHECK(header.record_stride % shard_record_alignment == 0 && header.record_stride >= record_size);
+
+        ShardFile shard;
+        shard.Open(path);
+        LANTERN_CHECK(shard.GetWidth() == width && shard.GetHeight() == height && shard.GetChannels() == channels);
+        LANTERN_CHECK(shard.Size() == total_records);
+        LANTERN_CHECK(shard.GetTotalClass() == 4);
+        auto names = ClassNames();
+        for (uint32_t c = 0; c < names.size(); c++)
+        {
+            LANTERN_CHECK(shard.GetClassName(c) == names[c]);
+        }
+        uint32_t wrong = 0;
+        for (uint32_t r = 0; r < total_records; r++)
+        {
+            wrong += shard.GetLabelId(r) == LabelOf(r) ? 0 : 1;
+            const uint8_t *record = shard.GetRecord(r);
+            for (uint32_t i = 0; i < record_size; i++)
+            {
+                wrong += record[i] == PixelOf(r, i) ? 0 : 1;
+            }
+        }
+        LANTERN_CHECK(wrong == 0);
+
+        // a moved shard keep its mapping
+        ShardFile moved(std::move(shard));
+        LANTERN_CHECK(moved.Size() == total_records && moved.GetRecord(total_records - 1)[0] == PixelOf(total_records - 1, 0));
+
+        ShardFile empty;
+        empty.Open(WriteShard("empty.lsh", 0));
+        LANTERN_CHECK(empty.Size() == 0 && empty.GetTotalClass() == 4);
+    }
+
+    // a label outside the class table is refused by the writer and by the reader
+    void TestLabelOutOfRange()
+    {
+        auto names = ClassNames();
+        ShardWriter writer;
+        writer.Open(Directory() / "writer.lsh", width, height, channels, names);
+        uint8_t pixels[record_size] = {};
+        bool rejected = false;
+        try
+        {
+            writer.Append(4, pixels);
+        }
+        catch (const std::runtime_error &)
+        {
+            rejected = true;
+        }
+        LANTERN_CHECK(rejected);
+        writer.Close();
+
+        auto path = WriteShard("label.lsh", total_records);
+        ShardHeader header = ReadHeader(path);
+        uint32_t label = 4;
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(header.labels_offset + 3 * sizeof(uint32_t));
+            file.write(reinterpret_cast<const char *>(&label), sizeof(label));
+        }
+        LANTERN_CHECK(OpenFails(path));
+    }
+
+    // a shard cut anywhere, a corrupted class table or a foreign file is refused
+    void TestTruncated()
+    {
+        auto path = WriteShard("truncated.lsh", total_records);
+        ShardHeader header = ReadHeader(path);
+        uint64_t size = std::filesystem::file_size(path);
+        LANTERN_CHECK(size == header.labels_offset + total_records * sizeof(uint32_t));
+
+        // inside the label column, at the end and in the middle of the records, and inside the header
+        for (uint64_t cut : {size - 1, header.labels_offset - 1, header.records_offset + header.record_stride, (uint64_t)sizeof(ShardHeader) - 1})
+        {
+            auto copy = Directory() / "cut.lsh";
+            std::filesystem::copy_file(path, copy, std::filesystem::copy_options::overwrite_existing);
+            std::filesystem::resize_file(copy, cut);
+            LANTERN_CHECK(OpenFails(copy));
+        }
+
+        // class table shorter than its names
+        auto table = Directory() / "table.lsh";
+        std::filesystem::copy_file(path, table, std::filesystem::copy_options::overwrite_existing);
+        header.names_size = 6;
+        {
+            std::fstream file(table, std::ios::binary | std::ios::in | std::ios::out);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        }
+        LANTERN_CHECK(OpenFails(table));
+
+        auto foreign = Directory() / "foreign.lsh";
+        std::ofstream(foreign, std::ios::binary) << std::string(8192, 'x');
+        LANTERN_CHECK(OpenFails(foreign));
+    }
+}
+
+int main()
+{
+    std::filesystem::remove_all(Directory());
+    std::filesystem::create_directories(Directory());
+    TestRoundTrip();
+    TestLabelOutOfRange();
+    TestTruncated();
+    std::filesystem::remove_all(Directory());
+    return LanternTestResult();
+}